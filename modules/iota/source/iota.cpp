@@ -1,6 +1,7 @@
 #include "iota/iota.hpp"
 
 #include <iostream>
+#include <map>
 #include <regex>
 #include <sstream>
 #include <vector>
@@ -16,6 +17,7 @@ enum struct TokenKind
     Comma,
     Semicolon,
     ColonColon,
+    StringLiteral,
 };
 
 struct Token {
@@ -123,6 +125,20 @@ std::vector<Token> lex(const std::istream& input) {
         } else if (lexer.current() == ';') {
             kind = TokenKind::Semicolon;
             ++lexer;
+        } else if (lexer.current() == '"') {
+            kind = TokenKind::StringLiteral;
+            ++lexer;
+            while (!lexer.atEnd() && lexer.current() != '"') {
+                if (lexer.current() == '\\') {
+                    ++lexer;
+                }
+                tokenText.push_back(lexer.current());
+                ++lexer;
+            }
+            if (lexer.atEnd()) {
+                kind = TokenKind::SomethingElse;
+            }
+            ++lexer;
         } else if (lexer.atIdentifierStart()) {
             while (lexer.atIdentifierPart()) {
                 ++lexer;
@@ -138,7 +154,7 @@ std::vector<Token> lex(const std::istream& input) {
             ++lexer;
         }
 
-        if (tokenText.empty()) {
+        if (tokenText.empty() && kind != TokenKind::StringLiteral) {
             tokenText = lexer.tokenText();
         }
 
@@ -148,11 +164,17 @@ std::vector<Token> lex(const std::istream& input) {
     return tokens;
 }
 
+struct Variant {
+    Token name;
+    // The source text that maps to this variant, if any.
+    std::string spelling;
+};
+
 struct Iota {
     bool parseSuccess = false;
     std::vector<Token> namespaces;
     Token name;
-    std::vector<Token> variants;
+    std::vector<Variant> variants;
 };
 
 struct ParserError final : std::runtime_error {
@@ -191,8 +213,16 @@ struct Parser {
         iota.namespaces.emplace_back(std::move(ns));
     }
 
-    void pushVariant(const Token& variant) {
-        iota.variants.emplace_back(variant);
+    void pushVariant(const Token& variant, std::string spelling) {
+        if (!spelling.empty()) {
+            for (const auto& [name, existing] : iota.variants) {
+                if (existing == spelling) {
+                    throw ParserError{"spelling \"" + spelling + "\" is used by both " + name.text + " and " +
+                                      variant.text};
+                }
+            }
+        }
+        iota.variants.push_back({variant, std::move(spelling)});
     }
 
     void operator++() {
@@ -232,7 +262,15 @@ Iota parse(const std::vector<Token>& tokens) {
     parser.consume(TokenKind::IotaKeyword, "'=' must be followed by 'iota'");
     parser.consume(TokenKind::LeftBrace, "'iota' must be followed by '{'");
     while (!parser.atEnd() && !parser.atToken(TokenKind::RightBrace)) {
-        parser.pushVariant(parser.consume(TokenKind::Identifier, "variant name expected"));
+        const Token& variant = parser.consume(TokenKind::Identifier, "variant name expected");
+        std::string spelling;
+        if (parser.atToken(TokenKind::StringLiteral)) {
+            spelling = parser.next().text;
+            if (spelling.empty()) {
+                throw ParserError{"spelling of " + variant.text + " must not be empty"};
+            }
+        }
+        parser.pushVariant(variant, std::move(spelling));
         parser.consume(TokenKind::Comma, "comma expected after variant name");
     }
     parser.consume(TokenKind::RightBrace, "expected '}' after variant names");
@@ -259,32 +297,120 @@ void printNamespaces(std::ostream& output, const std::vector<Token>& namespaces)
     }
 }
 
+std::ostream& indented(std::ostream& output, const size_t indent) {
+    for (size_t level = 0; level < indent; ++level) {
+        output << "    ";
+    }
+    return output;
+}
+
+std::string escape(const std::string& text, const char quote) {
+    std::string result;
+    for (const char c : text) {
+        if (c == quote || c == '\\') {
+            result.push_back('\\');
+        }
+        result.push_back(c);
+    }
+    return result;
+}
+
+// Emits a switch on text[index] that narrows the candidates (all the same length) until one is left, and then
+// compares the rest of the text against it.
+void emitSpellingSwitch(
+    std::ostream& output,
+    const std::vector<const Variant*>& candidates,
+    const size_t index,
+    const size_t indent) {
+    if (candidates.size() == 1) {
+        const Variant& variant = *candidates.front();
+        if (index == variant.spelling.size()) {
+            indented(output, indent) << "return " << variant.name.text << ";\n";
+        } else {
+            indented(output, indent) << "if (text.substr(" << index << ") == \""
+                                     << escape(variant.spelling.substr(index), '"') << "\") {\n";
+            indented(output, indent + 1) << "return " << variant.name.text << ";\n";
+            indented(output, indent) << "}\n";
+            indented(output, indent) << "return std::nullopt;\n";
+        }
+        return;
+    }
+    std::map<char, std::vector<const Variant*>> byCharacter;
+    for (const Variant* variant : candidates) {
+        byCharacter[variant->spelling[index]].push_back(variant);
+    }
+    indented(output, indent) << "switch (text[" << index << "]) {\n";
+    for (const auto& [c, group] : byCharacter) {
+        indented(output, indent) << "case '" << escape(std::string(1, c), '\'') << "':\n";
+        emitSpellingSwitch(output, group, index + 1, indent + 1);
+    }
+    indented(output, indent) << "default:\n";
+    indented(output, indent + 1) << "return std::nullopt;\n";
+    indented(output, indent) << "}\n";
+}
+
+// Emits fromSpelling(), which maps source text to its variant with a switch on the length and then on each
+// character, so a lookup never touches more than one candidate's text.
+void emitSpellingLookup(std::ostream& output, const Iota& i) {
+    std::map<size_t, std::vector<const Variant*>> byLength;
+    for (const Variant& variant : i.variants) {
+        if (!variant.spelling.empty()) {
+            byLength[variant.spelling.size()].push_back(&variant);
+        }
+    }
+    if (byLength.empty()) {
+        return;
+    }
+    output << "constexpr std::optional<" << i.name.text << "> fromSpelling(const std::string_view text) {\n";
+    indented(output, 1) << "switch (text.size()) {\n";
+    for (const auto& [length, group] : byLength) {
+        indented(output, 1) << "case " << length << ":\n";
+        emitSpellingSwitch(output, group, 0, 2);
+    }
+    indented(output, 1) << "default:\n";
+    indented(output, 2) << "return std::nullopt;\n";
+    indented(output, 1) << "}\n";
+    output << "}\n";
+}
+
 void emitCode(std::ostream& output, const Iota& i) {
     output << "#pragma once\n";
     output << "#include <cstdint>\n";
+    output << "#include <optional>\n";
+    output << "#include <string_view>\n";
     if (!i.namespaces.empty()) {
         output << "namespace ";
         printNamespaces(output, i.namespaces);
         output << " {\n";
     }
     output << "struct " << i.name.text << " {\n";
-    output << "    std::uint64_t discriminant;\n";
-    output << "    const char* name;\n";
-    output << "    constexpr " << i.name.text
-           << "(const std::uint64_t discriminant, const char* name) : discriminant(discriminant), name(name) {}\n";
+    output << "    std::uint32_t discriminant;\n";
+    output << "    constexpr explicit " << i.name.text
+           << "(const std::uint32_t discriminant) : discriminant(discriminant) {}\n";
     output << "    constexpr bool operator==(const " << i.name.text << "& other) const {\n";
     output << "        return discriminant == other.discriminant;\n";
     output << "    }\n";
+    output << "    [[nodiscard]] constexpr const char* name() const;\n";
     output << "};\n";
     const std::string namespaceName = pluralize(i.name.text);
     output << "namespace " << namespaceName << " {\n";
     size_t iotaValue = 0;
-    for (const auto& [kind, text] : i.variants) {
-        output << "constexpr " << i.name.text << " " << text << "{" << iotaValue << ", \"" << text << "\"};\n";
+    for (const auto& [name, spelling] : i.variants) {
+        output << "constexpr " << i.name.text << " " << name.text << "{" << iotaValue << "};\n";
         ++iotaValue;
     }
-    output << "constexpr " << i.name.text << " Count{" << iotaValue << ", \"Count\"};\n";
+    output << "constexpr " << i.name.text << " Count{" << iotaValue << "};\n";
+    output << "constexpr const char* NAMES[] = {\n";
+    for (const auto& [name, spelling] : i.variants) {
+        output << "    \"" << name.text << "\",\n";
+    }
+    output << "    \"Count\",\n";
+    output << "};\n";
+    emitSpellingLookup(output, i);
     output << "} // namespace " << namespaceName << "\n";
+    output << "constexpr const char* " << i.name.text << "::name() const {\n";
+    output << "    return " << namespaceName << "::NAMES[discriminant];\n";
+    output << "}\n";
     if (!i.namespaces.empty()) {
         output << "} // namespace ";
         printNamespaces(output, i.namespaces);
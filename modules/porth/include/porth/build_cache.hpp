@@ -0,0 +1,42 @@
+#pragma once
+
+#include "porth/op.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace porth {
+
+constexpr std::uintmax_t BUILD_CACHE_CAPACITY = 256 * 1024 * 1024;
+
+// Names the executable com builds for a cross-referenced program. Hashes the ops with their source locations, which
+// end up in error messages, together with the codegen version and everything in toolchain: the backend, its options
+// and the compiler flags.
+std::string buildCacheKey(const std::vector<Op>& program, const std::vector<std::string>& toolchain);
+
+// Describes the compiler that PATH finds for name by its path, size and modification time, so that upgrading it
+// changes the cache key without having to run it.
+std::string compilerStamp(const std::string& name);
+
+// Describes the host CPU by the vendor, model and features that /proc/cpuinfo lists for it, since the C++ backend
+// compiles for the CPU it runs on. Empty where there is no /proc/cpuinfo.
+std::string hostCpuStamp();
+
+// A name next to path that no other process picks, to write to before renaming over path.
+std::filesystem::path temporaryPath(const std::filesystem::path& path);
+
+// Puts the executable cached under key at outputPath, through a hard link where the file system allows it and a copy
+// otherwise, and marks the entry as recently used. Returns false on a miss.
+bool fetchCachedBuild(const std::string& cacheDir, const std::string& key, const std::string& outputPath);
+
+// Adds the executable to the cache under key, then evicts the least recently used entries until the cache is no larger
+// than capacity. Entries are renamed into place and only ever replaced whole, so several processes can share a cache.
+bool storeCachedBuild(
+    const std::string& cacheDir,
+    const std::string& key,
+    const std::string& executablePath,
+    std::uintmax_t capacity);
+
+} // namespace porth
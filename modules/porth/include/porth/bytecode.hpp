@@ -0,0 +1,141 @@
+#pragma once
+
+#include "porth/op.hpp"
+#include "porth/source_map.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+namespace porth {
+
+// Opcodes of the simulator's instruction stream. The first ones mirror OpId one to one.
+enum struct Opcode : std::uint8_t {
+    Push,
+    Plus,
+    Minus,
+    Eq,
+    Ne,
+    Gt,
+    Lt,
+    Ge,
+    Le,
+    If,
+    Else,
+    End,
+    Print,
+    Dup,
+    Dup2,
+    Swap,
+    Drop,
+    While,
+    Do,
+    Mem,
+    Load,
+    Store,
+    Syscall1,
+    Syscall2,
+    Syscall3,
+    Syscall4,
+    Syscall5,
+    Syscall6,
+    Shr,
+    Shl,
+    Bor,
+    Band,
+    Over,
+    Mod,
+    // Fused sequences, only produced by lowerProgram. n is an immediate operand.
+    AddImm,     // n +  or  -n -
+    ShlImm,     // n shl
+    ShrImm,     // n shr
+    BandImm,    // n band
+    BorImm,     // n bor
+    LoadOffset, // n + ,
+    StoreImm,   // n .
+    DupLtImmDo, // dup n < do, with the target of do as second operand
+    // Loads and stores whose address provenAccesses has shown to be in bounds, so they skip the check.
+    LoadUnchecked,
+    StoreUnchecked,
+    LoadOffsetUnchecked,
+    StoreImmUnchecked,
+    // Ends the program; appended after the last op so the interpreter never checks for the end of the stream.
+    Halt,
+    Count,
+};
+
+constexpr std::size_t OPERAND_SIZE = sizeof(std::int64_t);
+
+// Opcodes are followed by this many unaligned 8-byte operands.
+constexpr std::size_t operandCount(const Opcode opcode) {
+    switch (opcode) {
+    case Opcode::Push:
+    case Opcode::If:
+    case Opcode::Else:
+    case Opcode::End:
+    case Opcode::Do:
+    case Opcode::AddImm:
+    case Opcode::ShlImm:
+    case Opcode::ShrImm:
+    case Opcode::BandImm:
+    case Opcode::BorImm:
+    case Opcode::LoadOffset:
+    case Opcode::StoreImm:
+    case Opcode::LoadOffsetUnchecked:
+    case Opcode::StoreImmUnchecked:
+        return 1;
+    case Opcode::DupLtImmDo:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+// Index of the operand holding a jump target, if the opcode has one.
+constexpr std::optional<std::size_t> jumpOperand(const Opcode opcode) {
+    switch (opcode) {
+    case Opcode::If:
+    case Opcode::Else:
+    case Opcode::End:
+    case Opcode::Do:
+        return 0;
+    case Opcode::DupLtImmDo:
+        return 1;
+    default:
+        return std::nullopt;
+    }
+}
+
+constexpr std::size_t instructionSize(const Opcode opcode) {
+    return 1 + operandCount(opcode) * OPERAND_SIZE;
+}
+
+inline std::int64_t readOperand(const std::uint8_t* const instruction, const std::size_t index = 0) {
+    std::int64_t operand;
+    std::memcpy(&operand, instruction + 1 + index * OPERAND_SIZE, OPERAND_SIZE);
+    return operand;
+}
+
+// A program lowered for the simulator: jump operands are byte offsets into code, and source locations live in a
+// separate array so the interpreter loop only ever touches the instruction stream.
+struct Bytecode {
+    std::vector<std::uint8_t> code;
+    // One entry per instruction before Halt, in stream order. Only read when reporting an error.
+    std::vector<LocationId> locations;
+    // Set when maxStackDepth proved the program can neither underflow nor grow the stack without bound.
+    std::optional<std::size_t> maxStackDepth;
+    // The memory size that the unchecked loads and stores were proven against. The bytecode must not run with less.
+    std::size_t provenMemory = 0;
+
+    // Location of the instruction starting at offset. Walks the stream, so keep it off hot paths.
+    [[nodiscard]] LocationId locationAt(std::size_t offset) const;
+};
+
+// Expects a program whose blocks have been cross-referenced. `while` only marks a jump target and is not emitted.
+// With fuseOps, common sequences that no jump lands inside become a single fused instruction. Loads and stores that
+// provenAccesses shows to stay below provenMemory go unchecked; with the default of 0, all of them are checked.
+Bytecode lowerProgram(const std::vector<Op>& program, bool fuseOps = true, std::size_t provenMemory = 0);
+
+} // namespace porth
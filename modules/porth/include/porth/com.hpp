@@ -1,12 +1,20 @@
 #pragma once
 
+#include "porth/mem.hpp"
 #include "porth/op.hpp"
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
 namespace porth {
 
-int compileProgram(const std::vector<Op>& program, const std::string& outFilePath);
+// Writes the program out as C++. Unless checkAllAccesses, loads and stores that provenAccesses shows to be in bounds
+// index mem directly; the rest report an invalid address like the simulator does.
+int compileProgram(
+    const std::vector<Op>& program,
+    const std::string& outFilePath,
+    std::size_t memoryCapacity = MEM_CAPACITY,
+    bool checkAllAccesses = false);
 
 }
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "porth/mem.hpp"
+#include "porth/op.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace porth {
+
+// Writes a static x86-64 Linux executable for the program, with no compiler or assembler involved: the machine code
+// is generated directly, along with a small runtime for output, syscalls and errors. The executable behaves like
+// simulateProgram, down to the error messages and the exit status. Unless checkAllAccesses, loads and stores that
+// provenAccesses shows to be in bounds go unchecked.
+int writeElfExecutable(
+    const std::vector<Op>& program,
+    const std::string& outFilePath,
+    std::size_t memoryCapacity = MEM_CAPACITY,
+    bool checkAllAccesses = false);
+
+} // namespace porth
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace porth {
+
+// A fast non-cryptographic 64-bit hash for cache keys. It is stable across runs and hosts of the same byte order.
+std::uint64_t hashBytes(std::string_view bytes, std::uint64_t seed = 0);
+
+} // namespace porth
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "porth/op.hpp"
+#include "porth/sim.hpp"
+
+#include <vector>
+
+namespace porth {
+
+// Translates the program into x86-64 machine code in executable memory of this process and runs it. Output, errors
+// and the exit status are the same as simulateProgram's. Throws SimulationError on hosts other than x86-64 with the
+// System V calling convention.
+int jitProgram(const std::vector<Op>& program, const SimulationOptions& options);
+
+} // namespace porth
@@ -1,23 +1,71 @@
 #pragma once
 
+#include "porth/scanner.hpp"
+#include "porth/source_map.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iota_generated/token_id.hpp>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace porth {
 
 struct Token {
     TokenId id;
-    std::string filePath;
-    size_t lineNumber;
-    size_t columnNumber;
-    std::string token;
-    Token(const TokenId id, std::string filePath, const size_t lineNumber, const size_t columnNumber, std::string token)
-        : id(id), filePath(std::move(filePath)), lineNumber(lineNumber), columnNumber(columnNumber),
-          token(std::move(token)) {
+    LocationId location;
+    // Points into the memory-mapped source file, which is never unmapped.
+    std::string_view token;
+    // The parsed value of an Int token.
+    std::int64_t value;
+    Token(const TokenId id, const LocationId location, const std::string_view token, const std::int64_t value = 0)
+        : id(id), location(location), token(token), value(value) {
     }
 };
 
-std::vector<Token> lexFile(const std::string& filePath);
+// Hands out the tokens of a source file one at a time, so the front end never has to hold all of them.
+struct Lexer {
+    explicit Lexer(const std::string& filePath, ScanMode mode = ScanMode::Scalar);
+    // Lexes a slice of a file that starts at the beginning of line firstLine, recording locations in the given map.
+    Lexer(std::string_view source, SourceMap& locations, SourceMap::FileId file, std::size_t firstLine, ScanMode mode);
+
+    std::optional<Token> next();
+
+  private:
+    std::optional<Token> nextScalar();
+    std::optional<Token> nextVector();
+    // Moves to the next boundary of the given kind at or after the current position, counting the lines passed.
+    std::size_t advanceTo(std::uint64_t ScanBlock::*boundaries);
+    void countNewlines(std::uint64_t newlines);
+    Token makeToken(std::size_t start, std::size_t end) const;
+
+    SourceMap& locations;
+    SourceMap::FileId file;
+    std::string_view source;
+    ScanMode mode;
+    Scanner scanner;
+    ScanBlock block;
+    std::size_t position = 0;
+    std::size_t lineNumber = 1;
+    std::size_t lineStart = 0;
+};
+
+std::vector<Token> lexFile(const std::string& filePath, ScanMode mode = ScanMode::Scalar);
+// Splits the file at line boundaries into threadCount chunks and lexes them concurrently. The tokens are the same as
+// lexFile's, in the same order. A threadCount of 0 uses one thread per hardware thread.
+std::vector<Token> lexFileParallel(
+    const std::string& filePath,
+    std::size_t threadCount,
+    ScanMode mode = ScanMode::Scalar);
+// Like lexFileParallel, but hands the tokens to consume in order once every chunk is lexed. An error is thrown after
+// consume has seen the tokens before it and none after, just where the sequential lexer would have thrown it.
+void lexFileParallel(
+    const std::string& filePath,
+    std::size_t threadCount,
+    ScanMode mode,
+    const std::function<void(const Token&)>& consume);
 
 } // namespace porth
@@ -1,9 +1,29 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 
 namespace porth {
 
+// Default size of a program's memory, in bytes.
 constexpr std::size_t MEM_CAPACITY = 640'000;
 
-}
+// Zero-filled memory of a simulated program. On POSIX hosts it is an anonymous mapping, so the kernel only zero-fills
+// the pages a program actually touches. Elsewhere it is allocated zeroed.
+struct Memory {
+    explicit Memory(std::size_t capacity);
+    ~Memory();
+    Memory(const Memory&) = delete;
+    Memory(Memory&&) = delete;
+    Memory& operator=(const Memory&) = delete;
+    Memory& operator=(Memory&&) = delete;
+
+    [[nodiscard]] std::uint8_t* data() const;
+    [[nodiscard]] std::size_t size() const;
+
+  private:
+    std::uint8_t* bytes = nullptr;
+    std::size_t capacity = 0;
+};
+
+} // namespace porth
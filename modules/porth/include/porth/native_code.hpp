@@ -0,0 +1,55 @@
+#pragma once
+
+#include "porth/op.hpp"
+#include "porth/x86_64.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace porth {
+
+// CheckedStack grows without bound. Native code instead reserves this many values for programs whose depth
+// maxStackDepth cannot prove, and reports an overflow past them.
+constexpr std::size_t UNPROVEN_STACK_CAPACITY = std::size_t{1} << 24;
+
+enum struct NativeFailure : std::int32_t {
+    StackUnderflow,
+    StackOverflow,
+    Load,
+    Store,
+};
+
+// What differs between machine code run inside this process and machine code in an executable of its own.
+// emitProgram expects these registers to be set up before the first op, and leaves them alone:
+//   rbx  points just past the top of the data stack
+//   rbp  end of the data stack
+//   r12  base of the program's memory
+//   r13  for the runtime
+//   r14  bottom of the data stack
+//   r15  size of the program's memory
+struct NativeRuntime {
+    NativeRuntime() = default;
+    virtual ~NativeRuntime() = default;
+    NativeRuntime(const NativeRuntime&) = delete;
+    NativeRuntime(NativeRuntime&&) = delete;
+    NativeRuntime& operator=(const NativeRuntime&) = delete;
+    NativeRuntime& operator=(NativeRuntime&&) = delete;
+
+    // Prints the value on top of the stack, leaving it there.
+    virtual void print(Assembler& a, std::size_t ip) = 0;
+    // Replaces the syscall number on top of the stack and the arity arguments below it with the result.
+    virtual void syscall(Assembler& a, std::size_t ip, std::size_t arity) = 0;
+    // Reached when the program runs off its end.
+    virtual void finish(Assembler& a) = 0;
+    // Reports the failure of op ip and stops. Loads and stores have the invalid address in rax.
+    virtual void fail(Assembler& a, std::size_t ip, NativeFailure failure) = 0;
+};
+
+// Appends the code for the ops, followed by the runtime's finish and the out-of-line failure paths. Stack bounds are
+// only checked with checkStack. Loads and stores that provenAccesses shows to stay below provenMemory go unchecked;
+// with 0, all of them are checked.
+void emitProgram(
+    Assembler& a, const std::vector<Op>& program, NativeRuntime& runtime, bool checkStack, std::size_t provenMemory);
+
+} // namespace porth
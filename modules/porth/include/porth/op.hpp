@@ -1,5 +1,7 @@
 #pragma once
 
+#include "porth/source_map.hpp"
+
 #include <cstdint>
 #include <iota_generated/op_id.hpp>
 #include <ostream>
@@ -8,15 +10,15 @@ namespace porth {
 
 struct Op {
     OpId id;
-    std::string filePath;
-    std::size_t lineNumber;
-    std::size_t columnNumber;
+    LocationId location;
     std::int64_t operand;
 
-    Op(OpId id, std::string filePath, std::size_t lineNumber, std::size_t columnNumber);
-    Op(OpId id, std::string filePath, std::size_t lineNumber, std::size_t columnNumber, std::int64_t operand);
+    Op(OpId id, LocationId location);
+    Op(OpId id, LocationId location, std::int64_t operand);
 };
 
+static_assert(sizeof(Op) == 16, "Op should stay small enough to fit four to a cache line");
+
 } // namespace porth
 
 std::ostream& operator<<(std::ostream& os, const porth::Op& op);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "porth/op.hpp"
+
+#include <ostream>
+#include <vector>
+
+namespace porth {
+
+enum struct OptimizationLevel {
+    // The program runs as written.
+    O0,
+    // All of the passes below.
+    O1,
+};
+
+// Rewrites a cross-referenced program into a smaller one that is cross-referenced the same way and behaves the same,
+// down to the errors it reports. The passes run in this order:
+//   fold-constants      computes arithmetic and comparisons on literals ahead of time
+//   fold-branches       replaces ifs and loops whose condition is a literal with the code that runs
+//   remove-no-ops       drops shuffles that cancel out, like `swap swap` and `dup drop`, and literal 0 operands of
+//                       `+`, `-`, `bor`, `shl` and `shr`, once the stack depth is proven
+//   remove-unreachable  drops the ops that no path reaches
+// Ops that are removed or merged leave the jumps around them renumbered. With dump, the program is written to it
+// after each pass.
+std::vector<Op> optimizeProgram(std::vector<Op> program, OptimizationLevel level, std::ostream* dump = nullptr);
+
+} // namespace porth
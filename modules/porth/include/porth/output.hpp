@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace porth {
+
+// Collects what a simulated program writes to stdout and stderr and hands it to the OS in large writes.
+// Pending bytes always belong to a single fd: writing to the other one flushes them first, so the two streams
+// interleave exactly as the program wrote them. Like C's stderr, fd 2 is written through by the end of every call.
+// Whatever is pending when the channel is destroyed, including while unwinding from an error, is flushed.
+struct OutputChannel {
+    static constexpr std::size_t CAPACITY = 64 * 1024;
+
+    OutputChannel() = default;
+    ~OutputChannel();
+    OutputChannel(const OutputChannel&) = delete;
+    OutputChannel(OutputChannel&&) = delete;
+    OutputChannel& operator=(const OutputChannel&) = delete;
+    OutputChannel& operator=(OutputChannel&&) = delete;
+
+    void write(const int fd, const std::string_view bytes) {
+        if (fd == pendingFd && bytes.size() <= CAPACITY - used && fd != 2) {
+            std::memcpy(buffer.data() + used, bytes.data(), bytes.size());
+            used += bytes.size();
+            return;
+        }
+        writeSlow(fd, bytes);
+    }
+
+    // Writes value in decimal followed by a newline to stdout.
+    void writeLine(const std::int64_t value) {
+        // the longest value is "-9223372036854775808\n"
+        constexpr std::size_t LONGEST = 21;
+        if (pendingFd != 1 || CAPACITY - used < LONGEST) {
+            switchTo(1);
+        }
+        char* const first = buffer.data() + used;
+        char* const last = std::to_chars(first, first + LONGEST, value).ptr;
+        *last = '\n';
+        used += static_cast<std::size_t>(last - first) + 1;
+    }
+
+    void flush();
+
+  private:
+    void writeSlow(int fd, std::string_view bytes);
+    // Flushes the pending bytes and makes fd the owner of the buffer.
+    void switchTo(int fd);
+
+    std::array<char, CAPACITY> buffer;
+    std::size_t used = 0;
+    int pendingFd = 1;
+};
+
+} // namespace porth
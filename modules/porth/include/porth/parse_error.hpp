@@ -0,0 +1,26 @@
+#pragma once
+
+#include "porth/source_map.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace porth {
+
+struct ParseError : std::runtime_error {
+    std::string message;
+    ParseError(const SourceLocation& location, const std::string& message);
+
+    [[nodiscard]] const char* what() const noexcept override;
+};
+
+struct UnknownWordError final : ParseError {
+    UnknownWordError(const SourceLocation& location, std::string_view word);
+};
+
+struct BadIntegerError final : ParseError {
+    BadIntegerError(const SourceLocation& location, std::string_view word);
+};
+
+} // namespace porth
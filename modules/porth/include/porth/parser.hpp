@@ -0,0 +1,30 @@
+#pragma once
+
+#include "porth/lexer.hpp"
+#include "porth/op.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace porth {
+
+Op parseTokenAsOp(const Token& token);
+
+// Backpatches block jump targets as ops are appended, so loading a program needs no separate pass over it.
+struct BlockResolver {
+    // Cross-references program[ip] with the blocks still open before it.
+    void resolve(std::vector<Op>& program, std::size_t ip);
+    // Fails if a block was left open at the end of the program.
+    void finish(const std::vector<Op>& program) const;
+
+  private:
+    std::vector<std::size_t> stack;
+};
+
+void crossReferenceBlocks(std::vector<Op>& program);
+
+// Lexing streams into the parser unless lexThreads asks for lexFileParallel, which needs all tokens up front.
+std::vector<Op> loadProgramFromFile(const std::string& inputFilePath, std::size_t lexThreads = 1);
+
+} // namespace porth
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "porth/bytecode.hpp"
+#include "porth/profile.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+
+namespace porth {
+
+enum struct PerfEvent {
+    // A software event: nanoseconds on the CPU, which even hosts without a PMU count.
+    TaskClock,
+    Instructions,
+    Cycles,
+    Branches,
+    BranchMisses,
+    L1DataMisses,
+    LastLevelMisses,
+    Count,
+};
+
+// Counters for the calling thread in user space, opened with perf_event_open. Events the host cannot count,
+// whether for lack of a PMU, of permission, or of Linux, are left out, and unavailableReason says why.
+struct PerfCounters {
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters(PerfCounters&&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    PerfCounters& operator=(PerfCounters&&) = delete;
+
+    void start();
+    void stop();
+    // Scaled up if the kernel had to multiplex the event with others. Nothing for events that could not be counted.
+    [[nodiscard]] std::optional<std::uint64_t> read(PerfEvent event) const;
+
+    std::string unavailableReason;
+
+  private:
+    std::array<int, static_cast<std::size_t>(PerfEvent::Count)> fds;
+};
+
+// The counters per executed instruction, plus IPC and miss rates.
+void writePerfStat(std::ostream& output, const PerfCounters& counters, std::uint64_t executedInstructions);
+
+// How many instructions of each class ran, from the counts of a profiled run.
+void writeInstructionMix(std::ostream& output, const Profile& profile, const Bytecode& bytecode);
+
+} // namespace porth
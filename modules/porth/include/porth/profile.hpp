@@ -0,0 +1,53 @@
+#pragma once
+
+#include "porth/bytecode.hpp"
+#include "porth/op.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace porth {
+
+// Unit of readTimestamp.
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+constexpr std::string_view TICK_UNIT = "cycles";
+
+inline std::uint64_t readTimestamp() {
+    return __rdtsc();
+}
+#else
+constexpr std::string_view TICK_UNIT = "ns";
+
+inline std::uint64_t readTimestamp() {
+    return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+}
+#endif
+
+// What a profiled simulation collects, indexed by the byte offset of each instruction in Bytecode::code.
+struct Profile {
+    // Also measure the ticks from the start of each instruction to the start of the next one.
+    bool measureTicks = false;
+    std::vector<std::uint64_t> counts;
+    std::vector<std::uint64_t> ticks;
+};
+
+// The source lines and instructions that ran the most, or took the most ticks when they were measured.
+void writeHotLines(std::ostream& output, const Profile& profile, const Bytecode& bytecode);
+
+// One line per instruction that ran, in the collapsed-stack format flamegraph.pl reads: the program, the blocks
+// around the instruction from the outermost in, and its location, followed by its ticks or count.
+void writeCollapsedStacks(
+    std::ostream& output, const Profile& profile, const Bytecode& bytecode, const std::vector<Op>& program);
+
+} // namespace porth
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "porth/op.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace porth {
+
+// Where the resolved program for sourcePath is cached: next to it as a .porthc file, or in cacheDir if one is given.
+std::string programCachePath(const std::string& sourcePath, const std::string& cacheDir);
+
+// Returns the cached program if the cache was built from a source with this hash and was written completely. The hash
+// covers both the text and the path of the source, since the cached locations name the file.
+std::optional<std::vector<Op>> readProgramCache(const std::string& cachePath, std::uint64_t sourceHash);
+// Writes to a temporary file and renames it into place, so readers never see a partial cache.
+bool writeProgramCache(const std::string& cachePath, std::uint64_t sourceHash, const std::vector<Op>& program);
+
+// Loads the program from its cache when the source is unchanged, and otherwise runs the front end and refreshes the
+// cache.
+std::vector<Op> loadProgramCached(const std::string& sourcePath, const std::string& cachePath, std::size_t lexThreads);
+
+} // namespace porth
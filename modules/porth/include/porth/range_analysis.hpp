@@ -0,0 +1,16 @@
+#pragma once
+
+#include "porth/op.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace porth {
+
+// Marks the loads and stores of a cross-referenced program whose address is provably below memoryCapacity on every
+// path that reaches them, so they can go without a bounds check. Tracks a range of values for each stack slot, and
+// narrows the ranges of values that a comparison tested on the way into an if or a loop body. Proves nothing for
+// programs whose stack depth stackDepths cannot prove.
+std::vector<bool> provenAccesses(const std::vector<Op>& program, std::size_t memoryCapacity);
+
+} // namespace porth
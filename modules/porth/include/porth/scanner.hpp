@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace porth {
+
+// The bytes std::isspace accepts in the "C" locale.
+constexpr bool isWhitespace(const char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+constexpr std::size_t SCAN_BLOCK_SIZE = 64;
+
+// One bit per byte of a block of source text. Bytes past the end of the source count as whitespace.
+struct ByteClasses {
+    std::uint64_t whitespace;
+    std::uint64_t newlines;
+    std::uint64_t slashes;
+};
+
+ByteClasses classifyBytesScalar(const char* bytes, std::size_t length);
+// Uses AVX2 or SSE2 when the build targets them, and classifyBytesScalar otherwise.
+ByteClasses classifyBytesVector(const char* bytes, std::size_t length);
+
+// How the lexer finds token boundaries: one character at a time, or a block at a time through Scanner. Scalar is the
+// default, since porth_bench measures the block scanner at parity with it.
+enum struct ScanMode {
+    Scalar,
+    Vector,
+};
+
+struct ScanBlock {
+    std::size_t offset = 0;
+    // The first byte of each token.
+    std::uint64_t tokenStarts = 0;
+    // The first whitespace byte after each token.
+    std::uint64_t tokenEnds = 0;
+    std::uint64_t newlines = 0;
+    // Tokens that are exactly "//", which comment out the rest of the line.
+    std::uint64_t commentStarts = 0;
+};
+
+// Walks source text a block at a time and turns byte classes into token boundaries.
+struct Scanner {
+    explicit Scanner(std::string_view source);
+
+    // Fills in the next block, or returns false past the end of the source.
+    bool next(ScanBlock& block);
+
+  private:
+    ByteClasses classify(std::size_t offset) const;
+
+    std::string_view source;
+    std::size_t offset = 0;
+    ByteClasses current{};
+    std::uint64_t previousWhitespace = 1;
+};
+
+} // namespace porth
@@ -1,11 +1,36 @@
 #pragma once
 
-#include "porth/op.hpp"
+#include "porth/bytecode.hpp"
+#include "porth/mem.hpp"
 
-#include <vector>
+#include <cstddef>
+#include <cstdint>
 
 namespace porth {
 
-void simulateProgram(const std::vector<Op>& program, bool debugMode);
+enum struct Engine {
+    // Every stack value lives in memory.
+    Stack,
+    // The top of the stack is kept in a register. Needs a proven stack depth, like the unchecked stack does.
+    CachedTop,
+};
 
-}
+struct Profile;
+
+struct SimulationOptions {
+    bool debugMode = false;
+    Engine engine = Engine::Stack;
+    std::size_t memoryCapacity = MEM_CAPACITY;
+    // Keeps the bounds check on loads and stores that provenAccesses shows to be in bounds. Read by jitProgram; the
+    // simulator runs whatever checks lowerProgram left in the bytecode.
+    bool checkAllAccesses = false;
+    // When set, the run is profiled into it.
+    Profile* profile = nullptr;
+    // When set, and profile is not, receives the number of instructions the run executed.
+    std::uint64_t* executedInstructions = nullptr;
+};
+
+// Returns the program's exit status: whatever it passed to the exit syscall, or 0 if it ran to the end.
+int simulateProgram(const Bytecode& bytecode, const SimulationOptions& options);
+
+} // namespace porth
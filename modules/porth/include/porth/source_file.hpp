@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace porth {
+
+// Read-only contents of a source file. On POSIX hosts the file is memory-mapped, elsewhere it is read into a buffer.
+struct MappedFile {
+    explicit MappedFile(const std::string& filePath);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    [[nodiscard]] std::string_view contents() const;
+
+  private:
+    const char* data = nullptr;
+    std::size_t size = 0;
+    std::string buffer;
+};
+
+// Maps the file for the rest of the process. Tokens point into the returned view, so it is never unmapped; the file is
+// mapped again once its size or modification time changes.
+std::string_view mapSourceFile(const std::string& filePath);
+
+} // namespace porth
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace porth {
+
+using LocationId = std::uint32_t;
+
+struct SourceLocation {
+    std::string_view filePath;
+    std::size_t lineNumber;
+    std::size_t columnNumber;
+};
+
+// Stores each file name once and each location as one packed word of file index, line and column.
+// Lines and columns beyond the packed range saturate instead of wrapping; more locations than a LocationId can tell
+// apart are an error.
+struct SourceMap {
+    using FileId = std::uint16_t;
+
+    FileId internFile(std::string_view filePath);
+    LocationId add(FileId file, std::size_t lineNumber, std::size_t columnNumber);
+    [[nodiscard]] SourceLocation resolve(LocationId location) const;
+    // Copies every location of other into this map and returns the id that other's location 0 now has.
+    LocationId append(const SourceMap& other);
+
+  private:
+    // deque, because resolved locations hand out views into these strings
+    std::deque<std::string> files;
+    std::vector<std::uint64_t> locations;
+};
+
+// The source map shared by every token and op in the process.
+SourceMap& sourceMap();
+
+} // namespace porth
+
+std::ostream& operator<<(std::ostream& os, const porth::SourceLocation& location);
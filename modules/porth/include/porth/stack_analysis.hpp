@@ -0,0 +1,27 @@
+#pragma once
+
+#include "porth/op.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace porth {
+
+// How many values an op needs on the stack and how many it leaves in their place.
+struct StackEffect {
+    std::size_t inputs;
+    std::size_t outputs;
+};
+
+StackEffect stackEffect(OpId id);
+
+// The depth of the stack on entry to each op, if maxStackDepth can prove the program safe. Ops that no path reaches
+// have none.
+std::optional<std::vector<std::optional<std::size_t>>> stackDepths(const std::vector<Op>& program);
+
+// Proves that no op of a cross-referenced program can underflow the stack, by checking that every path reaching an op
+// does so with the same depth. Returns the deepest the stack can get, or nothing if the program cannot be proven safe.
+std::optional<std::size_t> maxStackDepth(const std::vector<Op>& program);
+
+} // namespace porth
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "porth/output.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace porth {
+
+// Linux x86-64 numbers of the syscalls a program may make.
+namespace SyscallNumbers {
+constexpr std::int64_t READ = 0;
+constexpr std::int64_t WRITE = 1;
+constexpr std::int64_t OPEN = 2;
+constexpr std::int64_t CLOSE = 3;
+constexpr std::int64_t LSEEK = 8;
+constexpr std::int64_t MMAP = 9;
+constexpr std::int64_t EXIT = 60;
+constexpr std::int64_t OPENAT = 257;
+} // namespace SyscallNumbers
+
+// Thrown by the exit syscall to unwind the simulation with the program's exit status.
+struct ProgramExit {
+    int status;
+};
+
+// What a syscall may touch: the program's memory, which pointer arguments are offsets into, and its output.
+struct HostContext {
+    std::uint8_t* mem;
+    std::size_t memSize;
+    OutputChannel& output;
+};
+
+// In the order they are popped after the syscall number; the ones a syscallN op does not pass are 0.
+using SyscallArgs = std::array<std::int64_t, 6>;
+
+// Makes the syscall on the host. Pointer arguments are checked against mem and handed to the kernel as pointers into
+// it, so reads and writes go straight between files and the program's memory. Like the raw syscall, a failure
+// returns -errno. Returns nothing if number is not one of SyscallNumbers or the host cannot forward it.
+std::optional<std::int64_t> forwardSyscall(HostContext& host, std::int64_t number, const SyscallArgs& args);
+
+} // namespace porth
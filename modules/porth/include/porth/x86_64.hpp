@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace porth {
+
+enum struct Reg : std::uint8_t {
+    Rax,
+    Rcx,
+    Rdx,
+    Rbx,
+    Rsp,
+    Rbp,
+    Rsi,
+    Rdi,
+    R8,
+    R9,
+    R10,
+    R11,
+    R12,
+    R13,
+    R14,
+    R15,
+};
+
+// Numbered as in the encodings of jcc and setcc.
+enum struct Condition : std::uint8_t {
+    Below = 0x2,
+    AboveEqual = 0x3,
+    Equal = 0x4,
+    NotEqual = 0x5,
+    BelowEqual = 0x6,
+    Above = 0x7,
+    Sign = 0x8,
+    NotSign = 0x9,
+    Less = 0xC,
+    GreaterEqual = 0xD,
+    LessEqual = 0xE,
+    Greater = 0xF,
+};
+
+// Numbered as the reg field of the immediate forms; the register forms have opcode 8 * op + 1.
+enum struct AluOp : std::uint8_t {
+    Add = 0,
+    Or = 1,
+    And = 4,
+    Sub = 5,
+    Xor = 6,
+    Cmp = 7,
+};
+
+// [base + index + disp]
+struct Mem {
+    Reg base;
+    std::int32_t disp = 0;
+    std::optional<Reg> index = std::nullopt;
+};
+
+struct Label {
+    std::size_t id;
+};
+
+// Encodes x86-64 instructions, with 64-bit operands unless the name says otherwise. Jumps, calls and RIP-relative
+// operands refer to labels, which finish resolves to 32-bit displacements.
+struct Assembler {
+    Label newLabel();
+    void bind(Label label);
+    [[nodiscard]] std::size_t size() const;
+    void bytes(std::string_view data);
+
+    void mov(Reg dst, Reg src);
+    // Picks the shortest encoding for the value.
+    void mov(Reg dst, std::int64_t imm);
+    void mov(Reg dst, Mem src);
+    void mov(Mem dst, Reg src);
+    void mov(Mem dst, std::int32_t imm);
+    void movByte(Mem dst, Reg src);
+    void movByte(Mem dst, std::uint8_t imm);
+    void movzxByte(Reg dst, Mem src);
+    void movzxByte(Reg dst, Reg src);
+    void lea(Reg dst, Mem src);
+    void lea(Reg dst, Label label);
+    void alu(AluOp op, Reg dst, Reg src);
+    void alu(AluOp op, Reg dst, std::int32_t imm);
+    void alu(AluOp op, Mem dst, Reg src);
+    void alu(AluOp op, Mem dst, std::int32_t imm);
+    void cmpByte(Mem dst, std::uint8_t imm);
+    void test(Reg a, Reg b);
+    void shlCl(Mem dst);
+    void sarCl(Mem dst);
+    void cqo();
+    void idiv(Reg divisor);
+    void div(Reg divisor);
+    void neg(Reg reg);
+    void setcc(Condition condition, Reg dst);
+    void jump(Label target);
+    void jump(Condition condition, Label target);
+    void call(Label target);
+    void call(Reg target);
+    void ret();
+    void syscall();
+    void push(Reg reg);
+    void pop(Reg reg);
+    void repMovsb();
+    void repneScasb();
+
+    // The code with every label reference resolved. Every label that is referenced has to be bound.
+    [[nodiscard]] std::vector<std::uint8_t> finish() const;
+
+  private:
+    void emit(std::initializer_list<std::uint8_t> data);
+    void imm32(std::int32_t value);
+    // REX prefix for the given reg field, SIB index and base or r/m register; left out when it would be empty
+    // unless forced, which byte operands in spl, bpl, sil and dil need.
+    void rex(bool wide, Reg reg, std::optional<Reg> index, Reg base, bool force = false);
+    // ModRM, SIB and displacement for a memory operand.
+    void operand(Reg reg, Mem mem);
+    void operand(std::uint8_t extension, Mem mem);
+    void registers(Reg reg, Reg rm);
+    void displacement(Label target);
+
+    std::vector<std::uint8_t> code;
+    std::vector<std::optional<std::size_t>> labels;
+    // where a 32-bit displacement to the label goes; it is relative to the end of the displacement
+    std::vector<std::pair<std::size_t, Label>> references;
+};
+
+} // namespace porth
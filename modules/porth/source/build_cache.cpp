@@ -0,0 +1,187 @@
+#include "porth/build_cache.hpp"
+
+#include "porth/hash.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string_view>
+
+// Bump whenever a backend changes the executable it builds for the same program.
+constexpr std::uint32_t CODEGEN_VERSION = 1;
+
+#ifdef _WIN32
+constexpr char PATH_SEPARATOR = ';';
+constexpr const char EXECUTABLE_SUFFIX[] = ".exe";
+#else
+constexpr char PATH_SEPARATOR = ':';
+constexpr const char EXECUTABLE_SUFFIX[] = "";
+#endif
+
+template <typename T> void appendField(std::string& buffer, const T& value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof value);
+}
+
+// Length-prefixed, so that no two lists of strings hash the same bytes.
+void appendString(std::string& buffer, const std::string_view value) {
+    appendField(buffer, static_cast<std::uint64_t>(value.size()));
+    buffer.append(value);
+}
+
+std::string porth::buildCacheKey(const std::vector<Op>& program, const std::vector<std::string>& toolchain) {
+    std::string bytes;
+    appendField(bytes, CODEGEN_VERSION);
+    for (const std::string& part : toolchain) {
+        appendString(bytes, part);
+    }
+    for (const Op& op : program) {
+        const SourceLocation location = sourceMap().resolve(op.location);
+        appendField(bytes, op.id.discriminant);
+        appendField(bytes, op.operand);
+        appendString(bytes, location.filePath);
+        appendField(bytes, static_cast<std::uint64_t>(location.lineNumber));
+        appendField(bytes, static_cast<std::uint64_t>(location.columnNumber));
+    }
+    // two differently seeded hashes, so that a cache shared by many programs does not hand out the wrong one
+    std::ostringstream key;
+    key << std::hex << std::setfill('0') << std::setw(16) << hashBytes(bytes, 0) << std::setw(16)
+        << hashBytes(bytes, 1);
+    return key.str();
+}
+
+std::string porth::compilerStamp(const std::string& name) {
+    const char* const path = std::getenv("PATH");
+    std::string_view directories = path == nullptr ? "" : path;
+    while (!directories.empty()) {
+        const std::size_t end = std::min(directories.find(PATH_SEPARATOR), directories.size());
+        const std::filesystem::path candidate =
+            std::filesystem::path{directories.substr(0, end)} / (name + EXECUTABLE_SUFFIX);
+        directories.remove_prefix(std::min(end + 1, directories.size()));
+        // compilers are usually symlinks to a versioned binary
+        std::error_code error;
+        const std::filesystem::path compiler = std::filesystem::canonical(candidate, error);
+        if (error || !std::filesystem::is_regular_file(compiler, error)) {
+            continue;
+        }
+        const std::uintmax_t size = std::filesystem::file_size(compiler, error);
+        const std::filesystem::file_time_type time = std::filesystem::last_write_time(compiler, error);
+        if (error) {
+            continue;
+        }
+        std::ostringstream stamp;
+        stamp << compiler.string() << " " << size << " " << time.time_since_epoch().count();
+        return stamp.str();
+    }
+    return name;
+}
+
+std::string porth::hostCpuStamp() {
+    // the lines of the first processor that say which instructions it has
+    constexpr std::string_view FIELDS[] = {
+        "vendor_id",
+        "model name",
+        "flags",
+        "CPU implementer",
+        "CPU part",
+        "Features",
+    };
+    std::ifstream cpuinfo{"/proc/cpuinfo"};
+    std::string stamp;
+    for (std::string line; std::getline(cpuinfo, line) && !line.empty();) {
+        const std::string_view field = std::string_view{line}.substr(0, line.find_first_of("\t:"));
+        if (std::find(std::begin(FIELDS), std::end(FIELDS), field) != std::end(FIELDS)) {
+            stamp += line;
+            stamp += '\n';
+        }
+    }
+    return stamp;
+}
+
+std::filesystem::path porth::temporaryPath(const std::filesystem::path& path) {
+    std::ostringstream name;
+    name << path.filename().string() << ".tmp" << std::hex << std::random_device{}();
+    return path.parent_path() / name.str();
+}
+
+bool porth::fetchCachedBuild(const std::string& cacheDir, const std::string& key, const std::string& outputPath) {
+    const std::filesystem::path entry = std::filesystem::path{cacheDir} / key;
+    const std::filesystem::path temp = temporaryPath(outputPath);
+    std::error_code error;
+    std::filesystem::create_hard_link(entry, temp, error);
+    if (error) {
+        // another file system, or one without hard links
+        error.clear();
+        std::filesystem::copy_file(entry, temp, error);
+    }
+    if (!error) {
+        std::filesystem::rename(temp, outputPath, error);
+    }
+    if (error) {
+        std::filesystem::remove(temp, error);
+        return false;
+    }
+    // eviction goes by modification time; an entry evicted meanwhile lives on at outputPath
+    std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), error);
+    return true;
+}
+
+bool porth::storeCachedBuild(
+    const std::string& cacheDir,
+    const std::string& key,
+    const std::string& executablePath,
+    const std::uintmax_t capacity) {
+    const std::filesystem::path entry = std::filesystem::path{cacheDir} / key;
+    const std::filesystem::path temp = temporaryPath(entry);
+    std::error_code error;
+    std::filesystem::create_directories(cacheDir, error);
+    // a copy rather than a link, so that writing to executablePath later cannot change the entry
+    std::filesystem::copy_file(executablePath, temp, error);
+    if (!error) {
+        std::filesystem::rename(temp, entry, error);
+    }
+    if (error) {
+        std::filesystem::remove(temp, error);
+        return false;
+    }
+
+    struct CachedFile {
+        std::filesystem::path path;
+        std::uintmax_t size;
+        std::filesystem::file_time_type lastUsed;
+    };
+    std::vector<CachedFile> files;
+    std::uintmax_t totalSize = 0;
+    // temporary files that a crashed process left behind count too, and age out like entries
+    for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator{cacheDir, error}) {
+        std::error_code fileError;
+        if (file.path() == entry || !file.is_regular_file(fileError)) {
+            continue;
+        }
+        const std::uintmax_t size = file.file_size(fileError);
+        const std::filesystem::file_time_type lastUsed = file.last_write_time(fileError);
+        if (!fileError) {
+            files.push_back({file.path(), size, lastUsed});
+            totalSize += size;
+        }
+    }
+    if (const std::uintmax_t size = std::filesystem::file_size(entry, error); !error) {
+        totalSize += size;
+    }
+    std::sort(files.begin(), files.end(), [](const CachedFile& a, const CachedFile& b) {
+        return a.lastUsed < b.lastUsed;
+    });
+    for (const CachedFile& file : files) {
+        if (totalSize <= capacity) {
+            break;
+        }
+        // another process evicting at the same time may have removed it already
+        if (std::filesystem::remove(file.path, error)) {
+            totalSize -= file.size;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,206 @@
+#include "porth/bytecode.hpp"
+
+#include "porth/range_analysis.hpp"
+#include "porth/stack_analysis.hpp"
+
+#include <array>
+#include <cassert>
+#include <initializer_list>
+
+constexpr bool mirrors(const porth::OpId id, const porth::Opcode opcode) {
+    return id.discriminant == static_cast<std::uint32_t>(opcode);
+}
+
+static_assert(porth::OpIds::Count.discriminant == 34, "Exhaustive handling of OpIds in Opcode");
+static_assert(
+    mirrors(porth::OpIds::Push, porth::Opcode::Push) && mirrors(porth::OpIds::If, porth::Opcode::If) &&
+        mirrors(porth::OpIds::While, porth::Opcode::While) && mirrors(porth::OpIds::Do, porth::Opcode::Do) &&
+        mirrors(porth::OpIds::Syscall6, porth::Opcode::Syscall6) && mirrors(porth::OpIds::Mod, porth::Opcode::Mod),
+    "Opcode must list the OpIds in the same order");
+
+porth::LocationId porth::Bytecode::locationAt(const std::size_t offset) const {
+    std::size_t instruction = 0;
+    for (std::size_t at = 0; at < offset; at += instructionSize(static_cast<Opcode>(code[at]))) {
+        ++instruction;
+    }
+    assert(instruction < locations.size() && "locationAt: offset is past the last instruction");
+    return locations[instruction];
+}
+
+// One instruction of the stream, standing for ops [first, first + length) of the program.
+struct Instruction {
+    porth::Opcode opcode;
+    std::array<std::int64_t, 2> operands;
+    std::size_t first;
+    std::size_t length;
+    porth::LocationId location;
+};
+
+// Since `mem` pushes 0, `mem +` leaves the stack as it was. It still underflows on an empty stack, so it only needs no
+// instruction where maxStackDepth has proven that cannot happen.
+bool isMemOffset(const std::vector<porth::Op>& program, const std::size_t ip, const std::vector<bool>& isTarget) {
+    return program[ip].id == porth::OpIds::Mem && ip + 1 < program.size() &&
+           program[ip + 1].id == porth::OpIds::Plus && !isTarget[ip + 1];
+}
+
+std::optional<Instruction> fuseSequence(
+    const std::vector<porth::Op>& program,
+    const std::size_t ip,
+    const std::vector<bool>& isTarget,
+    const bool stackProven) {
+    namespace OpIds = porth::OpIds;
+    using porth::Opcode;
+    // Jumps may land on the first op of a fused sequence, but never inside it.
+    const auto matches = [&](const std::initializer_list<porth::OpId> ids) {
+        if (ip + ids.size() > program.size()) {
+            return false;
+        }
+        std::size_t at = ip;
+        for (const porth::OpId id : ids) {
+            if (program[at].id != id || (at != ip && isTarget[at])) {
+                return false;
+            }
+            ++at;
+        }
+        return true;
+    };
+    const std::int64_t immediate = program[ip].operand;
+    const auto fused = [&](const Opcode opcode, const std::size_t length, const std::int64_t operand) {
+        // report errors where the unfused sequence would have failed: at its last op, since the ones before it can only
+        // push or need no more values than it does
+        return Instruction{opcode, {operand, 0}, ip, length, program[ip + length - 1].location};
+    };
+
+    if (matches({OpIds::Dup, OpIds::Push, OpIds::Lt, OpIds::Do})) {
+        return Instruction{
+            Opcode::DupLtImmDo,
+            {program[ip + 1].operand, program[ip + 3].operand},
+            ip,
+            4,
+            program[ip].location,
+        };
+    }
+    // `n + ,` underflows at `+` and fails its load at `,`, so it keeps one location only where underflow is ruled out
+    if (stackProven && matches({OpIds::Push, OpIds::Plus, OpIds::Load})) {
+        return fused(Opcode::LoadOffset, 3, immediate);
+    }
+    if (matches({OpIds::Push, OpIds::Plus})) {
+        return fused(Opcode::AddImm, 2, immediate);
+    }
+    if (matches({OpIds::Push, OpIds::Minus})) {
+        // negated with wraparound, like the subtraction it replaces
+        return fused(Opcode::AddImm, 2, static_cast<std::int64_t>(0 - static_cast<std::uint64_t>(immediate)));
+    }
+    if (matches({OpIds::Push, OpIds::Shl})) {
+        return fused(Opcode::ShlImm, 2, immediate);
+    }
+    if (matches({OpIds::Push, OpIds::Shr})) {
+        return fused(Opcode::ShrImm, 2, immediate);
+    }
+    if (matches({OpIds::Push, OpIds::Band})) {
+        return fused(Opcode::BandImm, 2, immediate);
+    }
+    if (matches({OpIds::Push, OpIds::Bor})) {
+        return fused(Opcode::BorImm, 2, immediate);
+    }
+    if (matches({OpIds::Push, OpIds::Store})) {
+        return fused(Opcode::StoreImm, 2, immediate);
+    }
+    return std::nullopt;
+}
+
+// The same access without its bounds check.
+porth::Opcode unchecked(const porth::Opcode opcode) {
+    using porth::Opcode;
+    switch (opcode) {
+    case Opcode::Load:
+        return Opcode::LoadUnchecked;
+    case Opcode::Store:
+        return Opcode::StoreUnchecked;
+    case Opcode::LoadOffset:
+        return Opcode::LoadOffsetUnchecked;
+    case Opcode::StoreImm:
+        return Opcode::StoreImmUnchecked;
+    default:
+        return opcode;
+    }
+}
+
+porth::Bytecode porth::lowerProgram(
+    const std::vector<Op>& program, const bool fuseOps, const std::size_t provenMemory) {
+    std::vector<bool> isTarget(program.size() + 1);
+    for (const Op& op : program) {
+        if (jumpOperand(static_cast<Opcode>(op.id.discriminant))) {
+            isTarget[static_cast<std::size_t>(op.operand)] = true;
+        }
+    }
+
+    const std::optional<std::size_t> depth = maxStackDepth(program);
+    std::vector<Instruction> instructions;
+    instructions.reserve(program.size());
+    for (std::size_t ip = 0; ip < program.size();) {
+        if (program[ip].id == OpIds::While) {
+            // only marks a jump target
+            ++ip;
+        } else if (fuseOps && isMemOffset(program, ip, isTarget)) {
+            if (!depth) {
+                // adding 0 still needs a value to add it to
+                instructions.push_back({Opcode::AddImm, {0, 0}, ip, 2, program[ip + 1].location});
+            }
+            ip += 2;
+        } else if (const std::optional<Instruction> fused =
+                       fuseOps ? fuseSequence(program, ip, isTarget, depth.has_value()) : std::nullopt) {
+            instructions.push_back(*fused);
+            ip += fused->length;
+        } else {
+            const Op& op = program[ip];
+            instructions.push_back({static_cast<Opcode>(op.id.discriminant), {op.operand, 0}, ip, 1, op.location});
+            ++ip;
+        }
+    }
+
+    if (provenMemory > 0) {
+        const std::vector<bool> proven = provenAccesses(program, provenMemory);
+        for (Instruction& instruction : instructions) {
+            // a fused load or store is the last op of its sequence
+            if (proven[instruction.first + instruction.length - 1]) {
+                instruction.opcode = unchecked(instruction.opcode);
+            }
+        }
+    }
+
+    // Byte offset of every op, plus one for the Halt at the end, which is where jumps past the last op land. Ops that
+    // were elided or fused into an earlier instruction get the offset of the instruction after them.
+    std::vector<std::size_t> offsets(program.size() + 1);
+    std::size_t size = 0;
+    std::size_t next = 0;
+    for (const Instruction& instruction : instructions) {
+        while (next <= instruction.first) {
+            offsets[next++] = size;
+        }
+        size += instructionSize(instruction.opcode);
+    }
+    while (next <= program.size()) {
+        offsets[next++] = size;
+    }
+
+    Bytecode bytecode;
+    bytecode.code.reserve(size + 1);
+    bytecode.locations.reserve(instructions.size());
+    for (Instruction instruction : instructions) {
+        if (const std::optional<std::size_t> jump = jumpOperand(instruction.opcode)) {
+            std::int64_t& target = instruction.operands[*jump];
+            target = static_cast<std::int64_t>(offsets[static_cast<std::size_t>(target)]);
+        }
+        bytecode.code.push_back(static_cast<std::uint8_t>(instruction.opcode));
+        bytecode.locations.push_back(instruction.location);
+        const std::size_t at = bytecode.code.size();
+        const std::size_t operandBytes = operandCount(instruction.opcode) * OPERAND_SIZE;
+        bytecode.code.resize(at + operandBytes);
+        std::memcpy(bytecode.code.data() + at, instruction.operands.data(), operandBytes);
+    }
+    bytecode.code.push_back(static_cast<std::uint8_t>(Opcode::Halt));
+    bytecode.maxStackDepth = depth;
+    bytecode.provenMemory = provenMemory;
+    return bytecode;
+}
@@ -1,10 +1,16 @@
 #include "porth/com.hpp"
 
-#include "porth/mem.hpp"
+#include "porth/native_code.hpp"
+#include "porth/range_analysis.hpp"
+#include "porth/source_map.hpp"
+#include "porth/stack_analysis.hpp"
 
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <sstream>
+#include <string>
+#include <string_view>
 
 std::string labelName(const std::int64_t offset) {
     std::ostringstream result;
@@ -19,119 +25,256 @@ std::ostream& emit(std::ostream& output, const size_t indent) {
     return output;
 }
 
-int porth::compileProgram(const std::vector<Op>& program, const std::string& outFilePath) {
+// A C++ string literal with the given contents.
+std::string stringLiteral(const std::string_view text) {
+    std::string result = "\"";
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result + "\"";
+}
+
+// The same message the simulator reports when the op fails, as a C++ string literal.
+std::string failureMessage(const porth::Op& op, const std::string_view message) {
+    std::ostringstream text;
+    text << "[ERROR] " << porth::sourceMap().resolve(op.location) << ": " << message;
+    return stringLiteral(text.str());
+}
+
+// How the generated code refers to the values an op works on: slot k is its k-th input counting up from the deepest,
+// and also its k-th output, which take the inputs' place.
+struct StackSlots {
+    // Depth of the stack below the op's inputs, when it is known for every path to the op. Each depth then has a
+    // local of its own, which the C++ compiler can keep in a register. Otherwise the slots are relative to a stack
+    // pointer into a flat array.
+    std::optional<std::size_t> base;
+
+    std::string operator[](const std::size_t k) const {
+        std::ostringstream name;
+        if (base) {
+            name << "_porth_s" << *base + k;
+        } else {
+            name << "_porth_sp[" << k << "]";
+        }
+        return name.str();
+    }
+};
+
+// The same syscalls, with the same checks on pointers into mem, as porth::forwardSyscall in the simulator.
+constexpr std::string_view SYSCALL_RUNTIME = R"(
+static bool _porth_in_bounds(std::int64_t address, std::int64_t length) {
+    return address >= 0 && length >= 0 && static_cast<std::uint64_t>(address) <= mem.size() &&
+        static_cast<std::uint64_t>(length) <= mem.size() - static_cast<std::uint64_t>(address);
+}
+
+#ifdef __linux__
+static const char* _porth_string_at(std::int64_t address) {
+    if (!_porth_in_bounds(address, 1) || std::memchr(&mem[address], '\0', mem.size() - address) == nullptr) {
+        return nullptr;
+    }
+    return reinterpret_cast<const char*>(&mem[address]);
+}
+
+static std::int64_t _porth_result(std::int64_t value) {
+    return value < 0 ? -errno : value;
+}
+#endif
+
+// failure is the message to report an unsupported number with, as the simulator would.
+static std::int64_t _porth_syscall(
+    const char* failure, std::int64_t number, std::int64_t arg0, std::int64_t arg1, std::int64_t arg2,
+    std::int64_t arg3, std::int64_t arg4, std::int64_t arg5) {
+    // write
+    if (number == 1) {
+        if (!_porth_in_bounds(arg1, arg2)) {
+            return -EFAULT;
+        }
+        const char* bytes = reinterpret_cast<const char*>(mem.data() + arg1);
+        if (arg0 == 1) {
+            std::cout.write(bytes, arg2);
+            return arg2;
+        }
+        if (arg0 == 2) {
+            std::cerr.write(bytes, arg2);
+            return arg2;
+        }
+#ifdef __linux__
+        return _porth_result(::write(arg0, bytes, arg2));
+#else
+        return -EBADF;
+#endif
+    }
+    // exit
+    if (number == 60) {
+        std::exit(static_cast<int>(arg0));
+    }
+#ifdef __linux__
+    // read
+    if (number == 0) {
+        if (!_porth_in_bounds(arg1, arg2)) {
+            return -EFAULT;
+        }
+        std::cout.flush();
+        return _porth_result(::read(arg0, mem.data() + arg1, arg2));
+    }
+    // open
+    if (number == 2) {
+        const char* path = _porth_string_at(arg0);
+        return path == nullptr ? -EFAULT : _porth_result(::open(path, arg1, arg2));
+    }
+    // openat
+    if (number == 257) {
+        const char* path = _porth_string_at(arg1);
+        return path == nullptr ? -EFAULT : _porth_result(::openat(arg0, path, arg2, arg3));
+    }
+    // close, lseek
+    if (number == 3 || number == 8) {
+        if (arg0 == 1 || arg0 == 2) {
+            std::cout.flush();
+        }
+        return _porth_result(number == 3 ? ::close(arg0) : ::lseek(arg0, arg1, arg2));
+    }
+    // mmap, always private and writable over [arg0, arg0 + arg1) of mem
+    if (number == 9) {
+        if ((arg3 & MAP_TYPE) != MAP_PRIVATE || arg1 <= 0) {
+            return -EINVAL;
+        }
+        const long pageSize = sysconf(_SC_PAGESIZE);
+        if (arg0 % pageSize != 0) {
+            return -EINVAL;
+        }
+        const std::int64_t length = (arg1 + pageSize - 1) / pageSize * pageSize;
+        if (!_porth_in_bounds(arg0, length)) {
+            return -ENOMEM;
+        }
+        const int flags = MAP_PRIVATE | MAP_FIXED | (arg3 & MAP_ANONYMOUS);
+        void* mapping = ::mmap(&mem[arg0], length, PROT_READ | PROT_WRITE, flags, arg4, arg5);
+        return mapping == MAP_FAILED ? -errno : arg0;
+    }
+#endif
+    std::cout.flush();
+    std::cerr << failure << number << "\n";
+    std::exit(1);
+}
+
+)";
+
+int porth::compileProgram(
+    const std::vector<Op>& program,
+    const std::string& outFilePath,
+    const std::size_t memoryCapacity,
+    const bool checkAllAccesses) {
     std::ofstream output{outFilePath};
     if (!output) {
         std::cerr << "[ERROR] failed to open '" << outFilePath << "' for writing\n";
         return 1;
     }
+    const std::optional<std::vector<std::optional<std::size_t>>> depths = stackDepths(program);
+    const std::vector<bool> proven =
+        checkAllAccesses ? std::vector<bool>(program.size()) : provenAccesses(program, memoryCapacity);
     size_t indent = 0;
     output << "#include <array>\n";
+    output << "#include <cerrno>\n";
     output << "#include <cstdint>\n";
+    output << "#include <cstdlib>\n";
+    output << "#include <cstring>\n";
     output << "#include <iostream>\n";
-    output << "#include <stack>\n";
+    output << "#include <utility>\n";
+    output << "#ifdef __linux__\n";
+    output << "#include <fcntl.h>\n";
+    output << "#include <sys/mman.h>\n";
+    output << "#include <unistd.h>\n";
+    output << "#endif\n";
+    // static storage lands in .bss, which the kernel zero-fills lazily, and does not overflow the native stack.
+    // Page alignment lets mmap place files over it.
+    emit(output, indent) << "alignas(4096) static std::array<std::uint8_t, " << memoryCapacity << "> mem{};\n";
+    if (!depths) {
+        emit(output, indent) << "static std::array<std::int64_t, " << UNPROVEN_STACK_CAPACITY << "> _porth_stack;\n";
+    }
+    emit(output, indent) << "[[noreturn]] static void _porth_fail(const char* message) {\n";
+    emit(output, indent + 1) << "std::cout.flush();\n";
+    emit(output, indent + 1) << "std::cerr << message << \"\\n\";\n";
+    emit(output, indent + 1) << "std::exit(1);\n";
+    emit(output, indent) << "}\n";
+    emit(output, indent) << "[[noreturn]] static void _porth_fail(const char* message, std::uint64_t address) {\n";
+    emit(output, indent + 1) << "std::cout.flush();\n";
+    emit(output, indent + 1) << "std::cerr << message << address << \"\\n\";\n";
+    emit(output, indent + 1) << "std::exit(1);\n";
+    emit(output, indent) << "}\n";
+    output << SYSCALL_RUNTIME;
     emit(output, indent) << "int main() {\n";
     ++indent;
-    emit(output, indent) << "std::array<std::uint8_t, " << MEM_CAPACITY << "> mem;\n";
-    emit(output, indent) << "std::stack<std::int64_t> _porth_stack;\n";
+    if (depths) {
+        const std::optional<std::size_t> maxDepth = maxStackDepth(program);
+        for (std::size_t depth = 0; depth < *maxDepth; ++depth) {
+            emit(output, indent) << "std::int64_t _porth_s" << depth << " = 0;\n";
+        }
+    } else {
+        emit(output, indent) << "std::int64_t* _porth_sp = _porth_stack.data();\n";
+    }
     static_assert(OpIds::Count.discriminant == 34, "Exhaustive handling of OpIds in compileProgram");
     for (size_t ip = 0; ip < program.size(); ++ip) {
         const Op& op = program[ip];
-        emit(output, indent) << "// -- " << op.id.name << " --\n";
+        emit(output, indent) << "// -- " << op.id.name() << " --\n";
         output << labelName(static_cast<std::int64_t>(ip)) << ":\n";
+        const auto [inputs, outputs] = stackEffect(op.id);
+        StackSlots s;
+        if (depths) {
+            if (!(*depths)[ip]) {
+                // no path gets here
+                continue;
+            }
+            s.base = *(*depths)[ip] - inputs;
+        } else {
+            if (inputs > 0) {
+                emit(output, indent) << "if (_porth_sp - _porth_stack.data() < " << inputs << ") {\n";
+                emit(output, indent + 1) << "_porth_fail(" << failureMessage(op, "stack underflow") << ");\n";
+                emit(output, indent) << "}\n";
+                emit(output, indent) << "_porth_sp -= " << inputs << ";\n";
+            }
+            if (outputs > inputs) {
+                emit(output, indent) << "if (_porth_stack.data() + _porth_stack.size() - _porth_sp < " << outputs
+                                     << ") {\n";
+                emit(output, indent + 1) << "_porth_fail(" << failureMessage(op, "stack overflow") << ");\n";
+                emit(output, indent) << "}\n";
+            }
+        }
         if (op.id == OpIds::Push) {
-            emit(output, indent) << "_porth_stack.push(" << op.operand << ");\n";
+            emit(output, indent) << s[0] << " = " << op.operand << ";\n";
+        } else if (op.id == OpIds::Mem) {
+            emit(output, indent) << s[0] << " = 0;\n";
         } else if (op.id == OpIds::Plus) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a + b);\n";
-            --indent;
-            emit(output, indent) << "}\n";
+            emit(output, indent) << s[0] << " = " << s[0] << " + " << s[1] << ";\n";
         } else if (op.id == OpIds::Minus) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a - b);\n";
-            --indent;
-            emit(output, indent) << "}\n";
+            emit(output, indent) << s[0] << " = " << s[0] << " - " << s[1] << ";\n";
         } else if (op.id == OpIds::Eq) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a == b ? 1 : 0);\n";
-            --indent;
-            emit(output, indent) << "}\n";
+            emit(output, indent) << s[0] << " = " << s[0] << " == " << s[1] << " ? 1 : 0;\n";
         } else if (op.id == OpIds::Ne) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a != b ? 1 : 0);\n";
-            --indent;
-            emit(output, indent) << "}\n";
+            emit(output, indent) << s[0] << " = " << s[0] << " != " << s[1] << " ? 1 : 0;\n";
         } else if (op.id == OpIds::Gt) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a > b ? 1 : 0);\n";
-            --indent;
-            emit(output, indent) << "}\n";
+            emit(output, indent) << s[0] << " = " << s[0] << " > " << s[1] << " ? 1 : 0;\n";
         } else if (op.id == OpIds::Lt) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a < b ? 1 : 0);\n";
-            --indent;
-            emit(output, indent) << "}\n";
+            emit(output, indent) << s[0] << " = " << s[0] << " < " << s[1] << " ? 1 : 0;\n";
         } else if (op.id == OpIds::Ge) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a >= b ? 1 : 0);\n";
-            --indent;
-            emit(output, indent) << "}\n";
+            emit(output, indent) << s[0] << " = " << s[0] << " >= " << s[1] << " ? 1 : 0;\n";
         } else if (op.id == OpIds::Le) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a <= b ? 1 : 0);\n";
-            --indent;
-            emit(output, indent) << "}\n";
-        } else if (op.id == OpIds::If) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "if (a == 0) {\n";
-            ++indent;
-            emit(output, indent) << "goto " << labelName(op.operand) << ";\n";
-            --indent;
-            emit(output, indent) << "}\n";
-            --indent;
+            emit(output, indent) << s[0] << " = " << s[0] << " <= " << s[1] << " ? 1 : 0;\n";
+        } else if (op.id == OpIds::Shr) {
+            emit(output, indent) << s[0] << " = " << s[0] << " >> " << s[1] << ";\n";
+        } else if (op.id == OpIds::Shl) {
+            emit(output, indent) << s[0] << " = " << s[0] << " << " << s[1] << ";\n";
+        } else if (op.id == OpIds::Bor) {
+            emit(output, indent) << s[0] << " = " << s[0] << " | " << s[1] << ";\n";
+        } else if (op.id == OpIds::Band) {
+            emit(output, indent) << s[0] << " = " << s[0] << " & " << s[1] << ";\n";
+        } else if (op.id == OpIds::Mod) {
+            emit(output, indent) << s[0] << " = " << s[0] << " % " << s[1] << ";\n";
+        } else if (op.id == OpIds::If || op.id == OpIds::Do) {
+            emit(output, indent) << "if (" << s[0] << " == 0) {\n";
+            emit(output, indent + 1) << "goto " << labelName(op.operand) << ";\n";
             emit(output, indent) << "}\n";
         } else if (op.id == OpIds::Else) {
             emit(output, indent) << "goto " << labelName(op.operand) << ";\n";
@@ -139,200 +282,56 @@ int porth::compileProgram(const std::vector<Op>& program, const std::string& out
             if (op.operand != static_cast<std::int64_t>(ip) + 1) {
                 emit(output, indent) << "goto " << labelName(op.operand) << ";\n";
             }
+        } else if (op.id == OpIds::While) {
+            // nothing. just an anchor for the condition.
         } else if (op.id == OpIds::Print) {
-            emit(output, indent) << "std::cout << _porth_stack.top() << \"\\n\";\n";
+            emit(output, indent) << "std::cout << " << s[0] << " << \"\\n\";\n";
         } else if (op.id == OpIds::Dup) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.push(a);\n";
-            --indent;
-            emit(output, indent) << "}\n";
+            emit(output, indent) << s[1] << " = " << s[0] << ";\n";
         } else if (op.id == OpIds::Dup2) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a);\n";
-            emit(output, indent) << "_porth_stack.push(b);\n";
-            emit(output, indent) << "_porth_stack.push(a);\n";
-            emit(output, indent) << "_porth_stack.push(b);\n";
-            --indent;
-            emit(output, indent) << "}\n";
+            emit(output, indent) << s[2] << " = " << s[0] << ";\n";
+            emit(output, indent) << s[3] << " = " << s[1] << ";\n";
         } else if (op.id == OpIds::Swap) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(b);\n";
-            emit(output, indent) << "_porth_stack.push(a);\n";
-            --indent;
-            emit(output, indent) << "}\n";
-        } else if (op.id == OpIds::Drop) {
-            emit(output, indent) << "_porth_stack.pop();\n";
-        } else if (op.id == OpIds::While) {
-            // nothing. just an anchor for the condition.
-        } else if (op.id == OpIds::Do) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "if (a == 0) {\n";
-            ++indent;
-            emit(output, indent) << "goto " << labelName(op.operand) << ";\n";
-            --indent;
-            emit(output, indent) << "}\n";
-            --indent;
-            emit(output, indent) << "}\n";
-        } else if (op.id == OpIds::Mem) {
-            emit(output, indent) << "_porth_stack.push(0);\n";
-        } else if (op.id == OpIds::Load) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto addr = static_cast<std::size_t>(a);\n";
-            emit(output, indent) << "auto b = mem.at(addr);\n";
-            emit(output, indent) << "_porth_stack.push(static_cast<std::int64_t>(b));\n";
-            --indent;
-            emit(output, indent) << "}\n";
-        } else if (op.id == OpIds::Store) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto addr = static_cast<std::size_t>(a);\n";
-            emit(output, indent) << "mem.at(addr) = static_cast<std::uint8_t>(b);\n";
-            --indent;
-            emit(output, indent) << "}\n";
-        } else if (op.id == OpIds::Syscall1) {
-            std::cerr << "not implemented: syscall1\n";
-            return 1;
-        } else if (op.id == OpIds::Syscall2) {
-            std::cerr << "not implemented: syscall2\n";
-            return 1;
-        } else if (op.id == OpIds::Syscall3) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto syscallNumber = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto arg1 = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto arg2 = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto arg3 = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "if (syscallNumber == 1) {\n";
-            ++indent;
-            emit(output, indent) << "auto fd = arg1;\n";
-            emit(output, indent) << "auto buf = arg2;\n";
-            emit(output, indent) << "auto count = arg3;\n";
-            emit(output, indent) << "const std::string_view s = {\n";
-            ++indent;
-            emit(output, indent) << "reinterpret_cast<const char*>(&mem[buf]),\n";
-            emit(output, indent) << "static_cast<std::size_t>(count),\n";
-            --indent;
-            emit(output, indent) << "};\n";
-            emit(output, indent) << "if (fd == 1) {\n";
-            ++indent;
-            emit(output, indent) << "std::cout << s;\n";
-            --indent;
-            emit(output, indent) << "} else if (fd == 2) {\n";
-            ++indent;
-            emit(output, indent) << "std::cerr << s;\n";
-            --indent;
-            emit(output, indent) << "} else {\n";
-            ++indent;
-            emit(output, indent) << "std::cerr << \"syscall3: unknown file descriptor \" << fd;\n";
-            emit(output, indent) << "return 1;\n";
-            --indent;
-            emit(output, indent) << "}\n";
-            --indent;
-            emit(output, indent) << "} else {\n";
-            ++indent;
-            emit(output, indent) << "std::cerr << \"syscall3: unknown syscall \" << syscallNumber;\n";
-            emit(output, indent) << "return 1;\n";
-            --indent;
-            emit(output, indent) << "}\n";
-            --indent;
-            emit(output, indent) << "}\n";
-        } else if (op.id == OpIds::Syscall4) {
-            std::cerr << "not implemented: syscall4\n";
-            return 1;
-        } else if (op.id == OpIds::Syscall5) {
-            std::cerr << "not implemented: syscall5\n";
-            return 1;
-        } else if (op.id == OpIds::Syscall6) {
-            std::cerr << "not implemented: syscall6\n";
-            return 1;
-        } else if (op.id == OpIds::Shr) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a >> b);\n";
-            --indent;
-            emit(output, indent) << "}\n";
-        } else if (op.id == OpIds::Shl) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a << b);\n";
-            --indent;
-            emit(output, indent) << "}\n";
-        } else if (op.id == OpIds::Bor) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a | b);\n";
-            --indent;
-            emit(output, indent) << "}\n";
-        } else if (op.id == OpIds::Band) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a & b);\n";
-            --indent;
-            emit(output, indent) << "}\n";
+            emit(output, indent) << "std::swap(" << s[0] << ", " << s[1] << ");\n";
         } else if (op.id == OpIds::Over) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a);\n";
-            emit(output, indent) << "_porth_stack.push(b);\n";
-            emit(output, indent) << "_porth_stack.push(a);\n";
-            --indent;
-            emit(output, indent) << "}\n";
-        } else if (op.id == OpIds::Mod) {
-            emit(output, indent) << "{\n";
-            ++indent;
-            emit(output, indent) << "auto b = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "auto a = _porth_stack.top();\n";
-            emit(output, indent) << "_porth_stack.pop();\n";
-            emit(output, indent) << "_porth_stack.push(a % b);\n";
-            --indent;
-            emit(output, indent) << "}\n";
+            emit(output, indent) << s[2] << " = " << s[0] << ";\n";
+        } else if (op.id == OpIds::Drop) {
+            // nothing. the slot is free for the next push.
+        } else if (op.id == OpIds::Load || op.id == OpIds::Store) {
+            if (!proven[ip]) {
+                const std::string_view message =
+                    op.id == OpIds::Load ? "load: invalid memory address " : "store: invalid memory address ";
+                emit(output, indent) << "if (static_cast<std::uint64_t>(" << s[0] << ") >= mem.size()) {\n";
+                emit(output, indent + 1) << "_porth_fail(" << failureMessage(op, message) << ", " << s[0] << ");\n";
+                emit(output, indent) << "}\n";
+            }
+            if (op.id == OpIds::Load) {
+                emit(output, indent) << s[0] << " = mem[static_cast<std::size_t>(" << s[0] << ")];\n";
+            } else {
+                emit(output, indent) << "mem[static_cast<std::size_t>(" << s[0] << ")] = static_cast<std::uint8_t>("
+                                     << s[1] << ");\n";
+            }
+        } else if (
+            op.id == OpIds::Syscall1 || op.id == OpIds::Syscall2 || op.id == OpIds::Syscall3 ||
+            op.id == OpIds::Syscall4 || op.id == OpIds::Syscall5 || op.id == OpIds::Syscall6) {
+            // the syscall number is on top, with the arguments below it from the first on down
+            const std::size_t arity = inputs - 1;
+            std::ostringstream failure;
+            failure << "syscall" << arity << ": unsupported syscall ";
+            emit(output, indent) << s[0] << " = _porth_syscall(" << failureMessage(op, failure.str()) << ", "
+                                 << s[arity];
+            for (std::size_t i = 0; i < 6; ++i) {
+                output << ", ";
+                if (i < arity) {
+                    output << s[arity - 1 - i];
+                } else {
+                    output << "0";
+                }
+            }
+            output << ");\n";
+        }
+        if (!depths && outputs > 0) {
+            emit(output, indent) << "_porth_sp += " << outputs << ";\n";
         }
     }
     output << labelName(static_cast<std::int64_t>(program.size())) << ":\n";
@@ -0,0 +1,664 @@
+#include "porth/elf.hpp"
+
+#include "porth/native_code.hpp"
+#include "porth/output.hpp"
+#include "porth/source_map.hpp"
+#include "porth/stack_analysis.hpp"
+#include "porth/syscall.hpp"
+#include "porth/x86_64.hpp"
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace SyscallNumbers = porth::SyscallNumbers;
+using porth::AluOp;
+using porth::Assembler;
+using porth::Condition;
+using porth::Label;
+using porth::Mem;
+using porth::NativeFailure;
+using porth::Reg;
+
+constexpr std::uint64_t PAGE_SIZE = 4096;
+constexpr std::uint64_t CODE_ADDRESS = 0x400000;
+// Far enough above the code for any program, and low enough for the shortest immediates.
+constexpr std::uint64_t DATA_ADDRESS = 0x10000000;
+// The ELF header and two program headers, which the code follows.
+constexpr std::size_t HEADERS_SIZE = 64 + 2 * 56;
+
+// Offsets from r13 into the runtime's data.
+constexpr std::int32_t OUTPUT_USED = 0;
+// Numbers are formatted backwards from here. The byte at the end is free for a newline.
+constexpr std::int32_t DIGITS_END = 40;
+constexpr std::int32_t OUTPUT_BUFFER = 64;
+constexpr auto OUTPUT_CAPACITY = static_cast<std::int32_t>(porth::OutputChannel::CAPACITY);
+
+// Linux errno values, which the host's may not be.
+constexpr std::int32_t LINUX_EINTR = 4;
+constexpr std::int32_t LINUX_ENOMEM = 12;
+constexpr std::int32_t LINUX_EFAULT = 14;
+constexpr std::int32_t LINUX_EINVAL = 22;
+
+// Where the data stack goes, after the runtime's data. The program's memory is mapped when the executable starts
+// instead, since a segment that large makes exec fail with SIGSEGV, and the kernel reserves it in full.
+struct DataLayout {
+    explicit DataLayout(const std::size_t stackCapacity)
+        : stack(DATA_ADDRESS + roundUpToPage(OUTPUT_BUFFER + OUTPUT_CAPACITY)),
+          stackEnd(stack + stackCapacity * sizeof(std::int64_t)) {
+    }
+
+    static std::uint64_t roundUpToPage(const std::uint64_t size) {
+        return (size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    }
+
+    std::uint64_t stack;
+    std::uint64_t stackEnd;
+};
+
+// Output, syscalls and failures in the executable itself. Output to stdout is buffered like OutputChannel does, and
+// errors are reported the way the simulator's main reports a SimulationError.
+struct ElfRuntime : porth::NativeRuntime {
+    ElfRuntime(Assembler& a, const std::vector<porth::Op>& program)
+        : program(program),
+          flush(a.newLabel()),
+          writeAll(a.newLabel()),
+          formatSigned(a.newLabel()),
+          formatUnsigned(a.newLabel()),
+          printValue(a.newLabel()),
+          dispatch(a.newLabel()),
+          failPlain(a.newLabel()),
+          failSigned(a.newLabel()),
+          failUnsigned(a.newLabel()),
+          reportNumber(a.newLabel()) {
+    }
+
+    void print(Assembler& a, const std::size_t /*ip*/) override {
+        a.mov(Reg::Rax, Mem{Reg::Rbx, -8});
+        a.call(printValue);
+    }
+
+    void syscall(Assembler& a, const std::size_t ip, const std::size_t arity) override {
+        // the kernel's argument registers, which dispatch takes them in
+        constexpr std::array<Reg, 6> ARGUMENTS = {Reg::Rdi, Reg::Rsi, Reg::Rdx, Reg::R10, Reg::R8, Reg::R9};
+        a.mov(Reg::Rax, Mem{Reg::Rbx, -8});
+        for (std::size_t i = 0; i < ARGUMENTS.size(); ++i) {
+            if (i < arity) {
+                a.mov(ARGUMENTS[i], Mem{Reg::Rbx, static_cast<std::int32_t>(-16 - 8 * i)});
+            } else {
+                a.alu(AluOp::Xor, ARGUMENTS[i], ARGUMENTS[i]);
+            }
+        }
+        a.call(dispatch);
+        unsupportedSyscalls.push_back({a.newLabel(), ip, arity});
+        a.test(Reg::Rcx, Reg::Rcx);
+        a.jump(Condition::NotEqual, unsupportedSyscalls.back().label);
+        a.alu(AluOp::Sub, Reg::Rbx, static_cast<std::int32_t>(8 * (arity + 1)));
+        a.mov(Mem{Reg::Rbx}, Reg::Rax);
+        a.alu(AluOp::Add, Reg::Rbx, 8);
+    }
+
+    void finish(Assembler& a) override {
+        a.call(flush);
+        a.alu(AluOp::Xor, Reg::Rdi, Reg::Rdi);
+        a.mov(Reg::Rax, SyscallNumbers::EXIT);
+        a.syscall();
+
+        for (const UnsupportedSyscall& site : unsupportedSyscalls) {
+            a.bind(site.label);
+            a.mov(Reg::Rax, Mem{Reg::Rbx, -8});
+            std::ostringstream text;
+            text << "syscall" << site.arity << ": unsupported syscall ";
+            message(a, errorPrefix(site.ip) + text.str());
+            a.jump(failSigned);
+        }
+        emitOutput(a);
+        emitSyscalls(a);
+        emitFailures(a);
+    }
+
+    void fail(Assembler& a, const std::size_t ip, const NativeFailure failure) override {
+        switch (failure) {
+        case NativeFailure::StackUnderflow:
+            message(a, errorPrefix(ip) + "stack underflow\n");
+            a.jump(failPlain);
+            break;
+        case NativeFailure::StackOverflow:
+            message(a, errorPrefix(ip) + "stack overflow\n");
+            a.jump(failPlain);
+            break;
+        case NativeFailure::Load:
+            message(a, errorPrefix(ip) + "load: invalid memory address ");
+            a.jump(failUnsigned);
+            break;
+        case NativeFailure::Store:
+            message(a, errorPrefix(ip) + "store: invalid memory address ");
+            a.jump(failUnsigned);
+            break;
+        }
+    }
+
+    // r12 = the program's memory of the given size, mapped like porth::Memory does, or zero when it is empty. Exits
+    // the way the simulator reports an allocation failure if the kernel cannot map it.
+    void allocateMemory(Assembler& a, const std::size_t capacity) {
+        if (capacity == 0) {
+            a.alu(AluOp::Xor, Reg::R12, Reg::R12);
+            return;
+        }
+        constexpr std::int32_t PROT_READ_WRITE = 0x03;
+        constexpr std::int32_t MAP_PRIVATE_ANONYMOUS_NORESERVE = 0x02 | 0x20 | 0x4000;
+        const Label mapped = a.newLabel();
+        a.alu(AluOp::Xor, Reg::Rdi, Reg::Rdi);
+        a.mov(Reg::Rsi, static_cast<std::int64_t>(capacity));
+        a.mov(Reg::Rdx, PROT_READ_WRITE);
+        a.mov(Reg::R10, MAP_PRIVATE_ANONYMOUS_NORESERVE);
+        a.mov(Reg::R8, -1);
+        a.alu(AluOp::Xor, Reg::R9, Reg::R9);
+        a.mov(Reg::Rax, SyscallNumbers::MMAP);
+        a.syscall();
+        a.mov(Reg::R12, Reg::Rax);
+        // errors come back as -4095 to -1, which no mapping starts at
+        a.alu(AluOp::Cmp, Reg::Rax, -4095);
+        a.jump(Condition::Below, mapped);
+        std::ostringstream text;
+        text << "[ERROR] failed to allocate " << capacity << " bytes of memory\n";
+        message(a, text.str());
+        a.jump(failPlain);
+        a.bind(mapped);
+    }
+
+    // The messages the code refers to, which go after all of it.
+    void emitStrings(Assembler& a) const {
+        for (const auto& [label, text] : strings) {
+            a.bind(label);
+            a.bytes(text);
+        }
+    }
+
+  private:
+    struct UnsupportedSyscall {
+        Label label;
+        std::size_t ip;
+        std::size_t arity;
+    };
+
+    [[nodiscard]] std::string errorPrefix(const std::size_t ip) const {
+        std::ostringstream prefix;
+        prefix << "[ERROR] " << porth::sourceMap().resolve(program[ip].location) << ": ";
+        return prefix.str();
+    }
+
+    // rsi = text, rdx = its length
+    void message(Assembler& a, std::string text) {
+        const Label label = a.newLabel();
+        a.lea(Reg::Rsi, label);
+        a.mov(Reg::Rdx, static_cast<std::int64_t>(text.size()));
+        strings.emplace_back(label, std::move(text));
+    }
+
+    void saveAndFlush(Assembler& a, const std::initializer_list<Reg> registers) const {
+        for (const Reg reg : registers) {
+            a.push(reg);
+        }
+        a.call(flush);
+        for (auto reg = std::rbegin(registers); reg != std::rend(registers); ++reg) {
+            a.pop(*reg);
+        }
+    }
+
+    static void exitProcess(Assembler& a, const std::int64_t status) {
+        a.mov(Reg::Rdi, status);
+        a.mov(Reg::Rax, SyscallNumbers::EXIT);
+        a.syscall();
+    }
+
+    // The routines below keep rbx, rbp and r12 to r15, and are free to use every other register.
+    void emitOutput(Assembler& a) {
+        // flush: hands the buffered stdout bytes to the kernel.
+        a.bind(flush);
+        const Label empty = a.newLabel();
+        a.mov(Reg::Rdx, Mem{Reg::R13, OUTPUT_USED});
+        a.test(Reg::Rdx, Reg::Rdx);
+        a.jump(Condition::Equal, empty);
+        a.mov(Mem{Reg::R13, OUTPUT_USED}, 0);
+        a.lea(Reg::Rsi, Mem{Reg::R13, OUTPUT_BUFFER});
+        a.mov(Reg::Rdi, 1);
+        a.jump(writeAll);
+        a.bind(empty);
+        a.ret();
+
+        // writeAll: writes rdx bytes at rsi to fd rdi, retrying short and interrupted writes.
+        a.bind(writeAll);
+        const Label loop = a.newLabel();
+        const Label written = a.newLabel();
+        const Label failed = a.newLabel();
+        a.bind(loop);
+        a.test(Reg::Rdx, Reg::Rdx);
+        a.jump(Condition::Equal, written);
+        a.mov(Reg::Rax, SyscallNumbers::WRITE);
+        a.syscall();
+        a.alu(AluOp::Cmp, Reg::Rax, -LINUX_EINTR);
+        a.jump(Condition::Equal, loop);
+        a.test(Reg::Rax, Reg::Rax);
+        a.jump(Condition::Sign, failed);
+        a.alu(AluOp::Add, Reg::Rsi, Reg::Rax);
+        a.alu(AluOp::Sub, Reg::Rdx, Reg::Rax);
+        a.jump(loop);
+        a.bind(written);
+        a.ret();
+        // There is nowhere left to report a failure to write to stderr.
+        const Label report = a.newLabel();
+        a.bind(failed);
+        a.alu(AluOp::Cmp, Reg::Rdi, 2);
+        a.jump(Condition::NotEqual, report);
+        exitProcess(a, 1);
+        a.bind(report);
+        a.mov(Reg::Rax, Reg::Rdi);
+        message(a, "[ERROR] failed to write to file descriptor ");
+        a.alu(AluOp::Xor, Reg::R9, Reg::R9);
+        a.jump(reportNumber);
+
+        // formatSigned, formatUnsigned: the decimal digits of rax, at rsi with the length in rdx.
+        const Label digits = a.newLabel();
+        const Label digitLoop = a.newLabel();
+        const Label formatted = a.newLabel();
+        a.bind(formatSigned);
+        a.mov(Reg::R8, Reg::Rax);
+        a.test(Reg::Rax, Reg::Rax);
+        a.jump(Condition::NotSign, digits);
+        // the magnitude of the most negative value only fits unsigned, which is how div takes it
+        a.neg(Reg::Rax);
+        a.jump(digits);
+        a.bind(formatUnsigned);
+        a.alu(AluOp::Xor, Reg::R8, Reg::R8);
+        a.bind(digits);
+        a.lea(Reg::Rdi, Mem{Reg::R13, DIGITS_END});
+        a.mov(Reg::Rcx, 10);
+        a.bind(digitLoop);
+        a.alu(AluOp::Xor, Reg::Rdx, Reg::Rdx);
+        a.div(Reg::Rcx);
+        a.alu(AluOp::Add, Reg::Rdx, '0');
+        a.alu(AluOp::Sub, Reg::Rdi, 1);
+        a.movByte(Mem{Reg::Rdi}, Reg::Rdx);
+        a.test(Reg::Rax, Reg::Rax);
+        a.jump(Condition::NotEqual, digitLoop);
+        a.test(Reg::R8, Reg::R8);
+        a.jump(Condition::NotSign, formatted);
+        a.alu(AluOp::Sub, Reg::Rdi, 1);
+        a.movByte(Mem{Reg::Rdi}, std::uint8_t{'-'});
+        a.bind(formatted);
+        a.mov(Reg::Rsi, Reg::Rdi);
+        a.lea(Reg::Rdx, Mem{Reg::R13, DIGITS_END});
+        a.alu(AluOp::Sub, Reg::Rdx, Reg::Rdi);
+        a.ret();
+
+        // printValue: rax in decimal and a newline to stdout, like OutputChannel::writeLine.
+        a.bind(printValue);
+        const Label fits = a.newLabel();
+        // the longest value is "-9223372036854775808\n"
+        a.alu(AluOp::Cmp, Mem{Reg::R13, OUTPUT_USED}, OUTPUT_CAPACITY - 21);
+        a.jump(Condition::BelowEqual, fits);
+        a.mov(Reg::R8, Reg::Rax);
+        a.call(flush);
+        a.mov(Reg::Rax, Reg::R8);
+        a.bind(fits);
+        a.call(formatSigned);
+        a.mov(Reg::Rcx, Reg::Rdx);
+        a.mov(Reg::Rax, Mem{Reg::R13, OUTPUT_USED});
+        a.lea(Reg::Rdi, Mem{Reg::R13, OUTPUT_BUFFER, Reg::Rax});
+        a.repMovsb();
+        a.movByte(Mem{Reg::Rdi}, std::uint8_t{'\n'});
+        a.alu(AluOp::Add, Reg::Rdx, 1);
+        a.alu(AluOp::Add, Mem{Reg::R13, OUTPUT_USED}, Reg::Rdx);
+        a.ret();
+    }
+
+    // dispatch: makes syscall rax with the arguments in the kernel's registers, with the same checks as
+    // porth::forwardSyscall. Returns the result in rax and 0 in rcx, or 1 in rcx for a syscall it does not forward.
+    void emitSyscalls(Assembler& a) {
+        const Label write = a.newLabel();
+        const Label read = a.newLabel();
+        const Label open = a.newLabel();
+        const Label openat = a.newLabel();
+        const Label closeOrSeek = a.newLabel();
+        const Label mmap = a.newLabel();
+        const Label exit = a.newLabel();
+        const Label succeed = a.newLabel();
+        const Label efault = a.newLabel();
+        const Label einval = a.newLabel();
+        const Label enomem = a.newLabel();
+
+        a.bind(dispatch);
+        const std::pair<std::int64_t, Label> cases[] = {
+            {SyscallNumbers::WRITE, write},
+            {SyscallNumbers::READ, read},
+            {SyscallNumbers::OPEN, open},
+            {SyscallNumbers::OPENAT, openat},
+            {SyscallNumbers::CLOSE, closeOrSeek},
+            {SyscallNumbers::LSEEK, closeOrSeek},
+            {SyscallNumbers::MMAP, mmap},
+            {SyscallNumbers::EXIT, exit},
+        };
+        for (const auto& [number, label] : cases) {
+            a.alu(AluOp::Cmp, Reg::Rax, static_cast<std::int32_t>(number));
+            a.jump(Condition::Equal, label);
+        }
+        a.mov(Reg::Rcx, 1);
+        a.ret();
+
+        // Whether [address, address + length) lies within the program's memory, as unsigned comparisons that
+        // negative values fail too.
+        const auto checkBounds = [&](const Reg address, const Reg length, const Label outside) {
+            a.alu(AluOp::Cmp, address, Reg::R15);
+            a.jump(Condition::Above, outside);
+            a.mov(Reg::R11, Reg::R15);
+            a.alu(AluOp::Sub, Reg::R11, address);
+            a.alu(AluOp::Cmp, length, Reg::R11);
+            a.jump(Condition::Above, outside);
+        };
+        // The NUL-terminated string at the address in r11 has to end within the program's memory.
+        const auto checkString = [&]() {
+            a.alu(AluOp::Cmp, Reg::R11, Reg::R15);
+            a.jump(Condition::AboveEqual, efault);
+            a.lea(Reg::Rdi, Mem{Reg::R12, 0, Reg::R11});
+            a.mov(Reg::Rcx, Reg::R15);
+            a.alu(AluOp::Sub, Reg::Rcx, Reg::R11);
+            a.alu(AluOp::Xor, Reg::Rax, Reg::Rax);
+            a.repneScasb();
+            a.jump(Condition::NotEqual, efault);
+        };
+
+        a.bind(write);
+        const Label writeThrough = a.newLabel();
+        const Label writeBuffered = a.newLabel();
+        checkBounds(Reg::Rsi, Reg::Rdx, efault);
+        a.alu(AluOp::Add, Reg::Rsi, Reg::R12);
+        a.alu(AluOp::Cmp, Reg::Rdi, 1);
+        a.jump(Condition::Equal, writeBuffered);
+        a.alu(AluOp::Cmp, Reg::Rdi, 2);
+        a.jump(Condition::Equal, writeThrough);
+        a.mov(Reg::Rax, SyscallNumbers::WRITE);
+        a.syscall();
+        a.jump(succeed);
+        a.bind(writeBuffered);
+        a.mov(Reg::Rax, Mem{Reg::R13, OUTPUT_USED});
+        a.mov(Reg::Rcx, OUTPUT_CAPACITY);
+        a.alu(AluOp::Sub, Reg::Rcx, Reg::Rax);
+        a.alu(AluOp::Cmp, Reg::Rdx, Reg::Rcx);
+        a.jump(Condition::Above, writeThrough);
+        a.lea(Reg::Rdi, Mem{Reg::R13, OUTPUT_BUFFER, Reg::Rax});
+        a.mov(Reg::Rcx, Reg::Rdx);
+        a.alu(AluOp::Add, Mem{Reg::R13, OUTPUT_USED}, Reg::Rdx);
+        a.mov(Reg::Rax, Reg::Rdx);
+        a.repMovsb();
+        a.jump(succeed);
+        // stderr, and stdout writes too large for the buffer: whatever is pending goes first
+        a.bind(writeThrough);
+        saveAndFlush(a, {Reg::Rdi, Reg::Rsi, Reg::Rdx});
+        a.mov(Reg::R8, Reg::Rdx);
+        a.call(writeAll);
+        a.mov(Reg::Rax, Reg::R8);
+        a.jump(succeed);
+
+        a.bind(read);
+        checkBounds(Reg::Rsi, Reg::Rdx, efault);
+        // a prompt has to be on screen before the program waits for the answer
+        saveAndFlush(a, {Reg::Rdi, Reg::Rsi, Reg::Rdx});
+        a.alu(AluOp::Add, Reg::Rsi, Reg::R12);
+        a.mov(Reg::Rax, SyscallNumbers::READ);
+        a.syscall();
+        a.jump(succeed);
+
+        a.bind(open);
+        a.mov(Reg::R11, Reg::Rdi);
+        checkString();
+        a.lea(Reg::Rdi, Mem{Reg::R12, 0, Reg::R11});
+        a.mov(Reg::Rax, SyscallNumbers::OPEN);
+        a.syscall();
+        a.jump(succeed);
+
+        a.bind(openat);
+        a.mov(Reg::R8, Reg::Rdi);
+        a.mov(Reg::R11, Reg::Rsi);
+        checkString();
+        a.mov(Reg::Rdi, Reg::R8);
+        a.lea(Reg::Rsi, Mem{Reg::R12, 0, Reg::R11});
+        a.mov(Reg::Rax, SyscallNumbers::OPENAT);
+        a.syscall();
+        a.jump(succeed);
+
+        // whatever is pending for the fd belongs before it goes away or moves
+        a.bind(closeOrSeek);
+        const Label flushFirst = a.newLabel();
+        const Label forward = a.newLabel();
+        a.alu(AluOp::Cmp, Reg::Rdi, 1);
+        a.jump(Condition::Equal, flushFirst);
+        a.alu(AluOp::Cmp, Reg::Rdi, 2);
+        a.jump(Condition::NotEqual, forward);
+        a.bind(flushFirst);
+        saveAndFlush(a, {Reg::Rax, Reg::Rdi, Reg::Rsi, Reg::Rdx});
+        a.bind(forward);
+        a.syscall();
+        a.jump(succeed);
+
+        // Always private and writable, over whole pages of the program's memory, like porth::forwardSyscall.
+        a.bind(mmap);
+        constexpr std::int32_t MAP_TYPE = 0x0F;
+        constexpr std::int32_t MAP_PRIVATE = 0x02;
+        constexpr std::int32_t MAP_FIXED = 0x10;
+        constexpr std::int32_t MAP_ANONYMOUS = 0x20;
+        constexpr std::int32_t PROT_READ_WRITE = 0x3;
+        a.mov(Reg::Rcx, Reg::R10);
+        a.alu(AluOp::And, Reg::Rcx, MAP_TYPE);
+        a.alu(AluOp::Cmp, Reg::Rcx, MAP_PRIVATE);
+        a.jump(Condition::NotEqual, einval);
+        a.test(Reg::Rsi, Reg::Rsi);
+        a.jump(Condition::LessEqual, einval);
+        a.mov(Reg::Rcx, Reg::Rdi);
+        a.alu(AluOp::And, Reg::Rcx, static_cast<std::int32_t>(PAGE_SIZE - 1));
+        a.jump(Condition::NotEqual, einval);
+        a.alu(AluOp::Add, Reg::Rsi, static_cast<std::int32_t>(PAGE_SIZE - 1));
+        a.alu(AluOp::And, Reg::Rsi, -static_cast<std::int32_t>(PAGE_SIZE));
+        checkBounds(Reg::Rdi, Reg::Rsi, enomem);
+        a.push(Reg::Rdi);
+        a.alu(AluOp::Add, Reg::Rdi, Reg::R12);
+        a.mov(Reg::Rdx, PROT_READ_WRITE);
+        a.alu(AluOp::And, Reg::R10, MAP_ANONYMOUS);
+        a.alu(AluOp::Or, Reg::R10, MAP_PRIVATE | MAP_FIXED);
+        a.mov(Reg::Rax, SyscallNumbers::MMAP);
+        a.syscall();
+        a.pop(Reg::Rdx);
+        // errors are the last page of unsigned values
+        a.alu(AluOp::Cmp, Reg::Rax, -static_cast<std::int32_t>(PAGE_SIZE));
+        a.jump(Condition::Above, succeed);
+        a.mov(Reg::Rax, Reg::Rdx);
+        a.jump(succeed);
+
+        a.bind(exit);
+        saveAndFlush(a, {Reg::Rdi});
+        a.mov(Reg::Rax, SyscallNumbers::EXIT);
+        a.syscall();
+
+        const std::pair<Label, std::int32_t> errors[] = {
+            {efault, LINUX_EFAULT},
+            {einval, LINUX_EINVAL},
+            {enomem, LINUX_ENOMEM},
+        };
+        for (const auto& [label, error] : errors) {
+            a.bind(label);
+            a.mov(Reg::Rax, -static_cast<std::int64_t>(error));
+            a.jump(succeed);
+        }
+        a.bind(succeed);
+        a.alu(AluOp::Xor, Reg::Rcx, Reg::Rcx);
+        a.ret();
+    }
+
+    // failPlain: writes the message at rsi with length rdx to stderr after the pending output, and exits with 1.
+    // failSigned, failUnsigned: the same, with rax in decimal and a newline after the message.
+    void emitFailures(Assembler& a) {
+        a.bind(failPlain);
+        saveAndFlush(a, {Reg::Rsi, Reg::Rdx});
+        a.mov(Reg::Rdi, 2);
+        a.call(writeAll);
+        exitProcess(a, 1);
+
+        const Label failNumber = a.newLabel();
+        a.bind(failSigned);
+        a.mov(Reg::R9, 1);
+        a.jump(failNumber);
+        a.bind(failUnsigned);
+        a.alu(AluOp::Xor, Reg::R9, Reg::R9);
+        a.bind(failNumber);
+        saveAndFlush(a, {Reg::Rax, Reg::Rsi, Reg::Rdx});
+
+        // reportNumber: like failSigned without the flush, or like failUnsigned if r9 is 0.
+        const Label formatAsUnsigned = a.newLabel();
+        const Label formatted = a.newLabel();
+        a.bind(reportNumber);
+        a.push(Reg::Rax);
+        a.mov(Reg::Rdi, 2);
+        a.call(writeAll);
+        a.pop(Reg::Rax);
+        a.test(Reg::R9, Reg::R9);
+        a.jump(Condition::Equal, formatAsUnsigned);
+        a.call(formatSigned);
+        a.jump(formatted);
+        a.bind(formatAsUnsigned);
+        a.call(formatUnsigned);
+        a.bind(formatted);
+        a.movByte(Mem{Reg::R13, DIGITS_END}, std::uint8_t{'\n'});
+        a.alu(AluOp::Add, Reg::Rdx, 1);
+        a.mov(Reg::Rdi, 2);
+        a.call(writeAll);
+        exitProcess(a, 1);
+    }
+
+    const std::vector<porth::Op>& program;
+    std::vector<UnsupportedSyscall> unsupportedSyscalls;
+    std::vector<std::pair<Label, std::string>> strings;
+    Label flush;
+    Label writeAll;
+    Label formatSigned;
+    Label formatUnsigned;
+    Label printValue;
+    Label dispatch;
+    Label failPlain;
+    Label failSigned;
+    Label failUnsigned;
+    Label reportNumber;
+};
+
+// Little-endian, as every field of an x86-64 ELF file is.
+void append(std::vector<std::uint8_t>& file, const std::uint64_t value, const std::size_t size) {
+    for (std::size_t i = 0; i < size; ++i) {
+        file.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+}
+
+void appendSegment(
+    std::vector<std::uint8_t>& file,
+    const std::uint32_t flags,
+    const std::uint64_t address,
+    const std::uint64_t fileSize,
+    const std::uint64_t memorySize) {
+    constexpr std::uint32_t PT_LOAD = 1;
+    append(file, PT_LOAD, 4);
+    append(file, flags, 4);
+    // the code segment starts with the headers at the start of the file; the data segment has nothing in it
+    append(file, 0, 8);
+    append(file, address, 8);
+    append(file, address, 8);
+    append(file, fileSize, 8);
+    append(file, memorySize, 8);
+    append(file, PAGE_SIZE, 8);
+}
+
+int porth::writeElfExecutable(
+    const std::vector<Op>& program,
+    const std::string& outFilePath,
+    const std::size_t memoryCapacity,
+    const bool checkAllAccesses) {
+    const std::optional<std::size_t> depth = maxStackDepth(program);
+    const DataLayout layout{depth ? *depth : UNPROVEN_STACK_CAPACITY};
+
+    Assembler a;
+    ElfRuntime runtime{a, program};
+    a.mov(Reg::R13, static_cast<std::int64_t>(DATA_ADDRESS));
+    a.mov(Reg::Rbx, static_cast<std::int64_t>(layout.stack));
+    a.mov(Reg::R14, Reg::Rbx);
+    a.mov(Reg::Rbp, static_cast<std::int64_t>(layout.stackEnd));
+    runtime.allocateMemory(a, memoryCapacity);
+    a.mov(Reg::R15, static_cast<std::int64_t>(memoryCapacity));
+    emitProgram(a, program, runtime, !depth, checkAllAccesses ? 0 : memoryCapacity);
+    runtime.emitStrings(a);
+    const std::vector<std::uint8_t> code = a.finish();
+    const std::uint64_t codeSegmentSize = HEADERS_SIZE + code.size();
+    if (CODE_ADDRESS + codeSegmentSize > DATA_ADDRESS) {
+        std::cerr << "[ERROR] the program is too large for an ELF executable (" << code.size()
+                  << " bytes of machine code)\n";
+        return 1;
+    }
+
+    std::vector<std::uint8_t> file;
+    file.reserve(codeSegmentSize);
+    // ELF magic, 64-bit, little-endian, version 1, System V ABI, padding
+    file.insert(file.end(), {0x7F, 'E', 'L', 'F', 2, 1, 1, 0});
+    append(file, 0, 8);
+    constexpr std::uint16_t ET_EXEC = 2;
+    constexpr std::uint16_t EM_X86_64 = 62;
+    append(file, ET_EXEC, 2);
+    append(file, EM_X86_64, 2);
+    append(file, 1, 4);
+    // the code starts right after the headers
+    append(file, CODE_ADDRESS + HEADERS_SIZE, 8);
+    // program headers right after the ELF header, no section headers, no flags
+    append(file, 64, 8);
+    append(file, 0, 8);
+    append(file, 0, 4);
+    // sizes of the ELF header and of a program header, then the counts of program and section headers
+    append(file, 64, 2);
+    append(file, 56, 2);
+    append(file, 2, 2);
+    append(file, 64, 2);
+    append(file, 0, 2);
+    append(file, 0, 2);
+    constexpr std::uint32_t PF_X = 1;
+    constexpr std::uint32_t PF_W = 2;
+    constexpr std::uint32_t PF_R = 4;
+    appendSegment(file, PF_R | PF_X, CODE_ADDRESS, codeSegmentSize, codeSegmentSize);
+    appendSegment(file, PF_R | PF_W, DATA_ADDRESS, 0, layout.stackEnd - DATA_ADDRESS);
+    file.insert(file.end(), code.begin(), code.end());
+
+    std::ofstream output{outFilePath, std::ios::binary};
+    if (!output) {
+        std::cerr << "[ERROR] failed to open '" << outFilePath << "' for writing\n";
+        return 1;
+    }
+    output.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+    output.close();
+    if (!output) {
+        std::cerr << "[ERROR] failed to write '" << outFilePath << "'\n";
+        return 1;
+    }
+    std::error_code error;
+    std::filesystem::permissions(
+        outFilePath,
+        std::filesystem::perms::owner_exec | std::filesystem::perms::group_exec |
+            std::filesystem::perms::others_exec,
+        std::filesystem::perm_options::add,
+        error);
+    if (error) {
+        std::cerr << "[ERROR] failed to make '" << outFilePath << "' executable: " << error.message() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+#include "porth/hash.hpp"
+
+#include <cstring>
+
+constexpr std::uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325;
+constexpr std::uint64_t FNV_PRIME = 0x100000001b3;
+constexpr std::uint64_t GOLDEN_RATIO = 0x9e3779b97f4a7c15;
+
+constexpr std::uint64_t mix(std::uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53;
+    h ^= h >> 33;
+    return h;
+}
+
+// Eight bytes per step: xor, multiply, and fold the high half back down so later words mix with every earlier bit.
+// The tail goes through byte-wise FNV-1a, and a final avalanche spreads everything over the whole result.
+std::uint64_t porth::hashBytes(const std::string_view bytes, const std::uint64_t seed) {
+    std::uint64_t h = FNV_OFFSET_BASIS ^ mix(seed + bytes.size());
+    std::size_t i = 0;
+    for (; i + sizeof(std::uint64_t) <= bytes.size(); i += sizeof(std::uint64_t)) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes.data() + i, sizeof word);
+        h = (h ^ word) * GOLDEN_RATIO;
+        h ^= h >> 32;
+    }
+    for (; i < bytes.size(); ++i) {
+        h = (h ^ static_cast<unsigned char>(bytes[i])) * FNV_PRIME;
+    }
+    return mix(h);
+}
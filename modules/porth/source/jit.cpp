@@ -0,0 +1,298 @@
+#include "porth/jit.hpp"
+
+#include "porth/mem.hpp"
+#include "porth/native_code.hpp"
+#include "porth/output.hpp"
+#include "porth/simulation_error.hpp"
+#include "porth/source_map.hpp"
+#include "porth/stack_analysis.hpp"
+#include "porth/syscall.hpp"
+#include "porth/x86_64.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define PORTH_JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+#ifdef PORTH_JIT_SUPPORTED
+using porth::AluOp;
+using porth::Assembler;
+using porth::Condition;
+using porth::Label;
+using porth::Mem;
+using porth::NativeFailure;
+using porth::Reg;
+
+// What the host keeps for the callbacks of one run.
+struct JitRun {
+    const std::vector<porth::Op>& program;
+    porth::HostContext& host;
+    std::optional<int> exitStatus;
+    std::exception_ptr error;
+};
+
+// Read by the generated code at fixed offsets, so it has to stay standard layout.
+struct JitState {
+    std::int64_t* stackBase;
+    std::int64_t* stackLimit;
+    std::uint8_t* mem;
+    std::size_t memSize;
+    // Set by a callback when the program has to stop: it called exit or something failed.
+    bool stopped;
+    JitRun* run;
+};
+
+void recordError(JitState* state, const std::size_t ip, const std::string& message) {
+    std::ostringstream errorMessage;
+    errorMessage << porth::sourceMap().resolve(state->run->program[ip].location) << ": " << message;
+    state->run->error = std::make_exception_ptr(porth::SimulationError{errorMessage.str()});
+    state->stopped = true;
+}
+
+// The callbacks are entered from generated code, which has no unwind information, so nothing may be thrown out of
+// them. Whatever they catch is kept in the JitRun and rethrown once the generated code has returned.
+void jitFail(
+    JitState* state, const std::int32_t ip, const NativeFailure failure, const std::uint64_t address) noexcept {
+    try {
+        std::ostringstream message;
+        switch (failure) {
+        case NativeFailure::StackUnderflow:
+            message << "stack underflow";
+            break;
+        case NativeFailure::StackOverflow:
+            message << "stack overflow";
+            break;
+        case NativeFailure::Load:
+            message << "load: invalid memory address " << address;
+            break;
+        case NativeFailure::Store:
+            message << "store: invalid memory address " << address;
+            break;
+        }
+        recordError(state, static_cast<std::size_t>(ip), message.str());
+    } catch (...) {
+        state->run->error = std::current_exception();
+        state->stopped = true;
+    }
+}
+
+void jitPrint(JitState* state, const std::int64_t value) noexcept {
+    try {
+        state->run->host.output.writeLine(value);
+    } catch (...) {
+        state->run->error = std::current_exception();
+        state->stopped = true;
+    }
+}
+
+// top points just past the syscall number, which has the arguments below it.
+std::int64_t jitSyscall(
+    JitState* state, const std::int64_t* top, const std::int32_t arity, const std::int32_t ip) noexcept {
+    try {
+        const std::int64_t number = top[-1];
+        porth::SyscallArgs args{};
+        for (std::int32_t i = 0; i < arity; ++i) {
+            args[static_cast<std::size_t>(i)] = top[-2 - i];
+        }
+        if (const std::optional<std::int64_t> result = porth::forwardSyscall(state->run->host, number, args)) {
+            return *result;
+        }
+        std::ostringstream message;
+        message << "syscall" << arity << ": unsupported syscall " << number;
+        recordError(state, static_cast<std::size_t>(ip), message.str());
+    } catch (const porth::ProgramExit& exit) {
+        state->run->exitStatus = exit.status;
+        state->stopped = true;
+    } catch (...) {
+        state->run->error = std::current_exception();
+        state->stopped = true;
+    }
+    return 0;
+}
+
+// Calls back into the host for output, syscalls and failures, and returns to it at the end.
+struct JitRuntime : porth::NativeRuntime {
+    explicit JitRuntime(Assembler& a) : exit(a.newLabel()), fails(a.newLabel()) {
+    }
+
+    void print(Assembler& a, const std::size_t /*ip*/) override {
+        a.mov(Reg::Rdi, Reg::R13);
+        a.mov(Reg::Rsi, Mem{Reg::Rbx, -8});
+        a.mov(Reg::Rax, address(&jitPrint));
+        a.call(Reg::Rax);
+        exitIfStopped(a);
+    }
+
+    void syscall(Assembler& a, const std::size_t ip, const std::size_t arity) override {
+        a.mov(Reg::Rdi, Reg::R13);
+        a.mov(Reg::Rsi, Reg::Rbx);
+        a.mov(Reg::Rdx, static_cast<std::int64_t>(arity));
+        a.mov(Reg::Rcx, static_cast<std::int64_t>(ip));
+        a.mov(Reg::Rax, address(&jitSyscall));
+        a.call(Reg::Rax);
+        a.alu(AluOp::Sub, Reg::Rbx, static_cast<std::int32_t>(8 * (arity + 1)));
+        a.mov(Mem{Reg::Rbx}, Reg::Rax);
+        a.alu(AluOp::Add, Reg::Rbx, 8);
+        exitIfStopped(a);
+    }
+
+    void finish(Assembler& a) override {
+        a.bind(exit);
+        a.alu(AluOp::Add, Reg::Rsp, 8);
+        for (auto reg = SAVED_REGISTERS.rbegin(); reg != SAVED_REGISTERS.rend(); ++reg) {
+            a.pop(*reg);
+        }
+        a.ret();
+
+        // every failure shares one call into the host
+        a.bind(fails);
+        a.mov(Reg::Rcx, Reg::Rax);
+        a.mov(Reg::Rdi, Reg::R13);
+        a.mov(Reg::Rax, address(&jitFail));
+        a.call(Reg::Rax);
+        a.jump(exit);
+    }
+
+    void fail(Assembler& a, const std::size_t ip, const NativeFailure failure) override {
+        a.mov(Reg::Rsi, static_cast<std::int64_t>(ip));
+        a.mov(Reg::Rdx, static_cast<std::int64_t>(failure));
+        a.jump(fails);
+    }
+
+    // The System V callee-saved registers, all of which the generated code uses.
+    static constexpr std::array<Reg, 6> SAVED_REGISTERS = {Reg::Rbp, Reg::Rbx, Reg::R12, Reg::R13, Reg::R14, Reg::R15};
+
+  private:
+    template <typename Function>
+    static std::int64_t address(Function* function) {
+        return static_cast<std::int64_t>(reinterpret_cast<std::uintptr_t>(function));
+    }
+
+    void exitIfStopped(Assembler& a) const {
+        a.cmpByte(Mem{Reg::R13, static_cast<std::int32_t>(offsetof(JitState, stopped))}, 0);
+        a.jump(Condition::NotEqual, exit);
+    }
+
+    Label exit;
+    Label fails;
+};
+
+std::vector<std::uint8_t> translate(
+    const std::vector<porth::Op>& program, const bool checkStack, const std::size_t provenMemory) {
+    Assembler a;
+    JitRuntime runtime{a};
+    for (const Reg reg : JitRuntime::SAVED_REGISTERS) {
+        a.push(reg);
+    }
+    // which leaves rsp 16-byte aligned for the callbacks
+    a.alu(AluOp::Sub, Reg::Rsp, 8);
+    a.mov(Reg::R13, Reg::Rdi);
+    const auto field = [](const std::size_t offset) {
+        return Mem{Reg::R13, static_cast<std::int32_t>(offset)};
+    };
+    a.mov(Reg::Rbx, field(offsetof(JitState, stackBase)));
+    a.mov(Reg::R14, field(offsetof(JitState, stackBase)));
+    a.mov(Reg::Rbp, field(offsetof(JitState, stackLimit)));
+    a.mov(Reg::R12, field(offsetof(JitState, mem)));
+    a.mov(Reg::R15, field(offsetof(JitState, memSize)));
+    porth::emitProgram(a, program, runtime, checkStack, provenMemory);
+    return a.finish();
+}
+
+// The translated program, mapped writable only while it is copied in and executable from then on.
+struct ExecutableCode {
+    explicit ExecutableCode(const std::vector<std::uint8_t>& code) : size(code.size()) {
+        void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            throwMappingFailure();
+        }
+        std::memcpy(mapping, code.data(), size);
+        if (mprotect(mapping, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(mapping, size);
+            throwMappingFailure();
+        }
+        entry = mapping;
+    }
+
+    ~ExecutableCode() {
+        munmap(entry, size);
+    }
+
+    ExecutableCode(const ExecutableCode&) = delete;
+    ExecutableCode(ExecutableCode&&) = delete;
+    ExecutableCode& operator=(const ExecutableCode&) = delete;
+    ExecutableCode& operator=(ExecutableCode&&) = delete;
+
+    void run(JitState* state) const {
+        reinterpret_cast<void (*)(JitState*)>(entry)(state);
+    }
+
+  private:
+    [[noreturn]] void throwMappingFailure() const {
+        std::ostringstream errorMessage;
+        errorMessage << "failed to map " << size << " bytes of executable memory";
+        throw porth::SimulationError{errorMessage.str()};
+    }
+
+    void* entry = nullptr;
+    std::size_t size;
+};
+#endif
+
+int porth::jitProgram(const std::vector<Op>& program, const SimulationOptions& options) {
+#ifdef PORTH_JIT_SUPPORTED
+    const std::optional<std::size_t> depth = maxStackDepth(program);
+    const std::size_t stackCapacity = depth ? *depth : UNPROVEN_STACK_CAPACITY;
+    const ExecutableCode code{translate(program, !depth, options.checkAllAccesses ? 0 : options.memoryCapacity)};
+    if (options.debugMode) {
+        if (depth) {
+            std::cout << "[INFO] Stack depth is at most " << *depth << ", using an unchecked stack\n";
+        } else {
+            std::cout << "[INFO] Stack depth could not be proven, using a checked stack\n";
+        }
+    }
+
+    const Memory stack{stackCapacity * sizeof(std::int64_t)};
+    const Memory memory{options.memoryCapacity};
+    // the program's output goes around std::cout, so whatever is waiting in it has to go first
+    std::cout.flush();
+    OutputChannel output;
+    HostContext host{memory.data(), memory.size(), output};
+    JitRun run{program, host, std::nullopt, nullptr};
+    auto* const stackBase = reinterpret_cast<std::int64_t*>(stack.data());
+    JitState state{stackBase, stackBase + stackCapacity, memory.data(), memory.size(), false, &run};
+    code.run(&state);
+    if (run.error) {
+        std::rethrow_exception(run.error);
+    }
+    if (run.exitStatus) {
+        return *run.exitStatus;
+    }
+    output.flush();
+    if (options.debugMode) {
+        std::cout << "[INFO] Memory dump\n";
+        const std::string_view s{
+            reinterpret_cast<const char*>(memory.data()),
+            std::min<std::size_t>(memory.size(), 20),
+        };
+        std::cout << s << "\n";
+    }
+    return 0;
+#else
+    (void)program;
+    (void)options;
+    throw SimulationError{"the JIT needs an x86-64 host with the System V calling convention"};
+#endif
+}
@@ -1,56 +1,232 @@
 #include "porth/lexer.hpp"
 
-#include <fstream>
-#include <ranges/ranges.hpp>
-#include <sstream>
+#include "porth/parse_error.hpp"
+#include "porth/source_file.hpp"
 
-std::string_view::iterator trimLeft(std::string_view line, const std::string_view::iterator col) {
-    return std::find_if(col, line.end(), [](const char c) { return !std::isspace(c); });
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <exception>
+#include <thread>
+
+porth::Token lexInt(const porth::SourceMap& locations, const porth::LocationId location, const std::string_view text) {
+    std::int64_t value = 0;
+    if (const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        error != std::errc{} || end != text.data() + text.size()) {
+        throw porth::BadIntegerError{locations.resolve(location), text};
+    }
+    return {porth::TokenIds::Int, location, text, value};
 }
 
-porth::Token lexWord(
-    const std::string& filePath,
-    const std::size_t lineNumber,
-    const std::size_t columnNumber,
-    const std::string& text) {
-    for (const char c : text) {
-        if (!std::isdigit(c)) {
-            return {porth::TokenIds::Word, filePath, lineNumber, columnNumber, text};
+constexpr std::uint64_t bitsBelow(const std::size_t index) {
+    return (std::uint64_t{1} << index) - 1;
+}
+
+porth::Lexer::Lexer(const std::string& filePath, const ScanMode mode)
+    : Lexer(mapSourceFile(filePath), sourceMap(), sourceMap().internFile(filePath), 1, mode) {
+}
+
+porth::Lexer::Lexer(
+    const std::string_view source,
+    SourceMap& locations,
+    const SourceMap::FileId file,
+    const std::size_t firstLine,
+    const ScanMode mode)
+    : locations(locations), file(file), source(source), mode(mode), scanner(source), lineNumber(firstLine) {
+    scanner.next(block);
+}
+
+std::optional<porth::Token> porth::Lexer::next() {
+    if (mode == ScanMode::Vector) {
+        return nextVector();
+    }
+    return nextScalar();
+}
+
+std::optional<porth::Token> porth::Lexer::nextScalar() {
+    while (true) {
+        while (position < source.size() && isWhitespace(source[position])) {
+            if (source[position] == '\n') {
+                ++lineNumber;
+                lineStart = position + 1;
+            }
+            ++position;
+        }
+        if (position == source.size()) {
+            return std::nullopt;
+        }
+        const std::size_t start = position;
+        while (position < source.size() && !isWhitespace(source[position])) {
+            ++position;
         }
+        if (source.substr(start, position - start) == "//") {
+            position = std::min(source.find('\n', position), source.size());
+            continue;
+        }
+        return makeToken(start, position);
+    }
+}
+
+std::optional<porth::Token> porth::Lexer::nextVector() {
+    while (true) {
+        // Most tokens start and end inside the current block, which needs no loop over blocks.
+        const std::size_t index = position - block.offset;
+        if (const std::uint64_t starts = block.tokenStarts & ~bitsBelow(index); starts != 0) {
+            const auto start = static_cast<std::size_t>(std::countr_zero(starts));
+            if (const std::uint64_t ends = block.tokenEnds & ~bitsBelow(start);
+                ends != 0 && (block.commentStarts >> start & 1) == 0) {
+                const auto end = static_cast<std::size_t>(std::countr_zero(ends));
+                countNewlines(block.newlines & ~bitsBelow(index) & bitsBelow(start));
+                position = std::min(block.offset + end, source.size());
+                return makeToken(block.offset + start, position);
+            }
+        }
+        const std::size_t start = advanceTo(&ScanBlock::tokenStarts);
+        if (start == source.size()) {
+            return std::nullopt;
+        }
+        if (block.commentStarts >> (start - block.offset) & 1) {
+            advanceTo(&ScanBlock::newlines);
+            continue;
+        }
+        return makeToken(start, advanceTo(&ScanBlock::tokenEnds));
     }
-    return {porth::TokenIds::Int, filePath, lineNumber, columnNumber, text};
 }
 
-std::vector<porth::Token> lexLine(const std::string& filePath, const size_t lineNumber, std::string_view line) {
-    std::vector<porth::Token> result;
-    auto col = trimLeft(line, line.begin());
-    while (col != line.end()) {
-        const auto colEnd = std::find_if(col, line.end(), [](const char c) { return std::isspace(c); });
-        std::string tokenText{col, colEnd};
-        if (tokenText == "//") {
+std::size_t porth::Lexer::advanceTo(std::uint64_t ScanBlock::*const boundaries) {
+    while (position < source.size()) {
+        const std::size_t index = position - block.offset;
+        if (const std::uint64_t candidates = block.*boundaries & ~bitsBelow(index); candidates != 0) {
+            const auto found = static_cast<std::size_t>(std::countr_zero(candidates));
+            countNewlines(block.newlines & ~bitsBelow(index) & bitsBelow(found));
+            position = std::min(block.offset + found, source.size());
+            return position;
+        }
+        countNewlines(block.newlines & ~bitsBelow(index));
+        if (!scanner.next(block)) {
+            position = source.size();
             break;
         }
-        result.emplace_back(lexWord(filePath, lineNumber + 1, col - line.begin() + 1, tokenText));
-        col = trimLeft(line, colEnd);
+        position = block.offset;
     }
-    return result;
+    return source.size();
+}
+
+void porth::Lexer::countNewlines(const std::uint64_t newlines) {
+    if (newlines != 0) {
+        lineNumber += static_cast<std::size_t>(std::popcount(newlines));
+        lineStart = block.offset + SCAN_BLOCK_SIZE - static_cast<std::size_t>(std::countl_zero(newlines));
+    }
+}
+
+porth::Token porth::Lexer::makeToken(const std::size_t start, const std::size_t end) const {
+    const std::string_view text = source.substr(start, end - start);
+    const LocationId location = locations.add(file, lineNumber, start - lineStart + 1);
+    if (std::all_of(text.begin(), text.end(), [](const char c) { return c >= '0' && c <= '9'; })) {
+        return lexInt(locations, location, text);
+    }
+    return {TokenIds::Word, location, text};
 }
 
-std::vector<porth::Token> porth::lexFile(const std::string& filePath) {
+std::vector<porth::Token> porth::lexFile(const std::string& filePath, const ScanMode mode) {
     std::vector<Token> result;
-    const std::ifstream file{filePath};
-    if (!file) {
-        std::ostringstream errorMessage;
-        errorMessage << "failed to open " << filePath << " for reading";
-        throw std::runtime_error{errorMessage.str()};
-    }
-    std::stringstream source;
-    source << file.rdbuf();
-    std::string line;
-    size_t lineNumber = 0;
-    while (std::getline(source, line)) {
-        my_ranges::copy(lexLine(filePath, lineNumber, line), std::back_inserter(result));
-        ++lineNumber;
+    Lexer lexer{filePath, mode};
+    while (const std::optional<Token> token = lexer.next()) {
+        result.push_back(*token);
+    }
+    return result;
+}
+
+struct LexChunk {
+    std::string_view source;
+    std::size_t newlines = 0;
+    std::size_t firstLine = 1;
+    porth::SourceMap locations;
+    std::vector<porth::Token> tokens;
+    std::exception_ptr error;
+};
+
+template <typename Work> void runConcurrently(std::vector<LexChunk>& chunks, Work work) {
+    std::vector<std::thread> threads;
+    for (LexChunk& chunk : chunks) {
+        threads.emplace_back([&chunk, &work] {
+            try {
+                work(chunk);
+            } catch (...) {
+                chunk.error = std::current_exception();
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
     }
+}
+
+std::vector<porth::Token> porth::lexFileParallel(
+    const std::string& filePath,
+    const std::size_t threadCount,
+    const ScanMode mode) {
+    std::vector<Token> result;
+    lexFileParallel(filePath, threadCount, mode, [&result](const Token& token) { result.push_back(token); });
     return result;
 }
+
+void porth::lexFileParallel(
+    const std::string& filePath,
+    std::size_t threadCount,
+    const ScanMode mode,
+    const std::function<void(const Token&)>& consume) {
+    if (threadCount == 0) {
+        threadCount = std::max(1U, std::thread::hardware_concurrency());
+    }
+    const std::string_view source = mapSourceFile(filePath);
+
+    // There are no multi-line tokens, so every chunk but the first starts right after a newline.
+    std::vector<LexChunk> chunks(threadCount);
+    std::size_t chunkStart = 0;
+    for (std::size_t i = 0; i < threadCount; ++i) {
+        std::size_t chunkEnd = source.size();
+        if (i + 1 < threadCount) {
+            const std::size_t newline = source.find('\n', std::max(chunkStart, source.size() / threadCount * (i + 1)));
+            chunkEnd = newline == std::string_view::npos ? source.size() : newline + 1;
+        }
+        chunks[i].source = source.substr(chunkStart, chunkEnd - chunkStart);
+        chunkStart = chunkEnd;
+    }
+
+    runConcurrently(chunks, [](LexChunk& chunk) {
+        chunk.newlines = static_cast<std::size_t>(std::count(chunk.source.begin(), chunk.source.end(), '\n'));
+    });
+    for (const LexChunk& chunk : chunks) {
+        if (chunk.error) {
+            std::rethrow_exception(chunk.error);
+        }
+    }
+    std::size_t lineNumber = 1;
+    for (LexChunk& chunk : chunks) {
+        chunk.firstLine = lineNumber;
+        lineNumber += chunk.newlines;
+    }
+
+    // SourceMap is not thread-safe, so each chunk records its locations privately until the chunks are joined.
+    runConcurrently(chunks, [&filePath, mode](LexChunk& chunk) {
+        const SourceMap::FileId file = chunk.locations.internFile(filePath);
+        Lexer lexer{chunk.source, chunk.locations, file, chunk.firstLine, mode};
+        while (const std::optional<Token> token = lexer.next()) {
+            chunk.tokens.push_back(*token);
+        }
+    });
+
+    // A chunk that failed still holds the tokens before its error. Handing those over before the error, and nothing
+    // after it, lets consume report any error of its own in the same order as with the sequential lexer.
+    for (LexChunk& chunk : chunks) {
+        const LocationId base = sourceMap().append(chunk.locations);
+        for (Token& token : chunk.tokens) {
+            token.location += base;
+            consume(token);
+        }
+        if (chunk.error) {
+            std::rethrow_exception(chunk.error);
+        }
+    }
+}
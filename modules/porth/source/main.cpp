@@ -1,20 +1,29 @@
-#include "porth/builtin_words.hpp"
+#include "porth/build_cache.hpp"
+#include "porth/bytecode.hpp"
 #include "porth/com.hpp"
-#include "porth/lexer.hpp"
+#include "porth/elf.hpp"
+#include "porth/jit.hpp"
+#include "porth/mem.hpp"
 #include "porth/op.hpp"
+#include "porth/optimizer.hpp"
+#include "porth/parse_error.hpp"
+#include "porth/parser.hpp"
+#include "porth/perf_counters.hpp"
+#include "porth/profile.hpp"
+#include "porth/program_cache.hpp"
 #include "porth/semantic_error.hpp"
 #include "porth/sim.hpp"
 #include "porth/simulation_error.hpp"
 
+#include <charconv>
 #include <config.hpp>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
-#include <iota_generated/op_id.hpp>
-#include <iota_generated/token_id.hpp>
+#include <optional>
 #include <ranges/ranges.hpp>
 #include <regex>
 #include <span/span.hpp>
-#include <sstream>
-#include <stack>
 #include <string_view>
 #include <subprocess.h>
 #include <subprocess/destroy_guard.hpp>
@@ -28,6 +37,13 @@ using namespace std::string_view_literals;
 #define EXE_SUFFIX ""
 #endif
 
+// What the ELF backend writes only runs on x86-64 Linux, so elsewhere com goes through C++ by default.
+#if defined(__linux__) && defined(__x86_64__)
+constexpr bool ELF_BACKEND_BY_DEFAULT = true;
+#else
+constexpr bool ELF_BACKEND_BY_DEFAULT = false;
+#endif
+
 void printArgs(const char* const* args) {
     for (const char* const* p = args; *p != nullptr; ++p) {
         std::cout << *p << " ";
@@ -77,6 +93,24 @@ std::string replaceOrAppendExtension(
     return outFilePath + newExtension;
 }
 
+// Everything that goes into building the generated C++ besides the file names, which the build cache key includes.
+#ifdef _MSC_VER
+constexpr auto COMPILER = "cl";
+const std::vector<std::string> COMPILE_FLAGS{
+    "-nologo",    // suppress copyright message
+    "-w",         // suppress warning output
+    "-TP",        // this is c++ code
+    "-std:c++20", // set c++ standard
+    "-O2",        // optimization level
+    "-EHsc",      // c++ exception option
+};
+const std::vector<std::string> LINK_FLAGS{};
+#else
+constexpr auto COMPILER = "clang++";
+const std::vector<std::string> COMPILE_FLAGS{"-w", "-xc++", "-std=c++20", "-O2", "-march=native", "-c"};
+const std::vector<std::string> LINK_FLAGS{"-w", "-flto", "-static", "-march=native"};
+#endif
+
 int tryBuild(const std::string& cppOutputFilePath, const std::string& outFilePath) {
     const std::regex extensionPattern{"\\.cpp$"};
 
@@ -89,58 +123,41 @@ int tryBuild(const std::string& cppOutputFilePath, const std::string& outFilePat
 #ifdef _MSC_VER
     const std::string asmPath = replaceOrAppendExtension(cppOutputFilePath, extensionPattern, ".asm");
 
-    if (const int ret = tryRunSubprocess({
-            "cl",
-            "-nologo",           // suppress copyright message
-            "-w",                // suppress warning output
-            "-TP",               // this is c++ code
-            "-std:c++20",        // set c++ standard
-            "-O2",               // optimization level
-            "-EHsc",             // c++ exception option
+    std::vector<std::string> command{COMPILER};
+    command.insert(command.end(), COMPILE_FLAGS.begin(), COMPILE_FLAGS.end());
+    command.insert(
+        command.end(),
+        {
             cppOutputFilePath,   // file to compile
             "-Fo" + objPath,     // obj name
             "-Fa" + asmPath,     // also generate assembly
             "-Fe" + outFilePath, // also generate executable
             "-link",             // i want to link as well
         });
-        ret != 0) {
+    if (const int ret = tryRunSubprocess(command); ret != 0) {
         return ret;
     }
 #else
-    constexpr auto COMPILER = "clang++";
-
-    if (const int ret = tryRunSubprocess({
-            "/usr/bin/env",
-            COMPILER,
-            "-w",
-            "-xc++",
-            "-std=c++20",
-            "-O2",
-            "-march=native",
-            "-c",
-            cppOutputFilePath,
-            "-o",
-            objPath,
-        });
-        ret != 0) {
+    std::vector<std::string> compileCommand{"/usr/bin/env", COMPILER};
+    compileCommand.insert(compileCommand.end(), COMPILE_FLAGS.begin(), COMPILE_FLAGS.end());
+    compileCommand.insert(compileCommand.end(), {cppOutputFilePath, "-o", objPath});
+    if (const int ret = tryRunSubprocess(compileCommand); ret != 0) {
         return ret;
     }
-    if (const int ret = tryRunSubprocess({
-            "/usr/bin/env",
-            COMPILER,
-            "-w",
-            "-flto",
-            "-static",
-            "-march=native",
-            objPath,
-            "-o",
-            outFilePath,
-        });
-        ret != 0) {
+    std::vector<std::string> linkCommand{"/usr/bin/env", COMPILER};
+    linkCommand.insert(linkCommand.end(), LINK_FLAGS.begin(), LINK_FLAGS.end());
+    linkCommand.insert(linkCommand.end(), {objPath, "-o", outFilePath});
+    if (const int ret = tryRunSubprocess(linkCommand); ret != 0) {
         return ret;
     }
 #endif
 
+    // the intermediate files are named for this build only, so nothing would ever reuse them
+    std::error_code error;
+    std::filesystem::remove(objPath, error);
+#ifdef _MSC_VER
+    std::filesystem::remove(asmPath, error);
+#endif
     return 0;
 }
 
@@ -155,115 +172,41 @@ void usage(const char* thisProgram) {
     std::cerr << "Usage: " << thisProgram << " [OPTIONS] <SUBCOMMAND> [ARGS]\n";
     std::cerr << "  OPTIONS:\n";
     std::cerr << "    -debug                 Enable debug mode\n";
+    std::cerr << "    -checked               Check the address of every load and store, even where it is proven\n";
+    std::cerr << "                           to be in bounds\n";
+    std::cerr << "    -O0                    Run the program as written\n";
+    std::cerr << "    -O1                    Fold constants and remove no-ops and unreachable code (default)\n";
+    std::cerr << "    -dump-passes           Write the program to stderr after each optimization pass\n";
+    std::cerr << "    -lex-threads <n>       Lex the input on n threads (0: one per core, default: 1)\n";
+    std::cerr << "    -mem <bytes>           Size of the program's memory (default: " << porth::MEM_CAPACITY << ")\n";
     std::cerr << "  SUBCOMMANDS:\n";
-    std::cerr << "    sim <file>             Simulate the program\n";
+    std::cerr << "    sim [OPTIONS] <file>   Simulate the program\n";
+    std::cerr << "      OPTIONS:\n";
+    std::cerr << "        -cache             Cache the resolved program in <file>.porthc\n";
+    std::cerr << "        -cache-dir <dir>   Like -cache, but keep the cache in <dir>\n";
+    std::cerr << "        -no-fuse           Run every op on its own instead of fusing common sequences\n";
+    std::cerr << "        -engine=<name>     stack: keep the whole stack in memory (default)\n";
+    std::cerr << "                           tos: cache the top of the stack in a register\n";
+    std::cerr << "        -perfstat          Report hardware counters per executed instruction on stderr\n";
+    std::cerr << "        -perfstat=classes  Like -perfstat, but also break the instructions down by class\n";
+    std::cerr << "        -profile           Count how often each op runs, unfused, and write the hot lines\n";
+    std::cerr << "                           to <file>.prof and collapsed stacks for flamegraph.pl to <file>.folded\n";
+    std::cerr << "        -profile=cycles    Like -profile, but also measure the " << porth::TICK_UNIT
+              << " each instruction takes\n";
+    std::cerr << "    jit <file>             Translate the program to machine code in memory and run it\n";
     std::cerr << "    com [OPTIONS] <file>   Compile the program\n";
-}
-
-struct ParseError : std::runtime_error {
-    std::string message;
-    ParseError(
-        const std::string& filePath,
-        const std::size_t lineNumber,
-        const std::size_t columnNumber,
-        const std::string& message)
-        : std::runtime_error(message) {
-        std::ostringstream msgStream;
-        msgStream << filePath << ":" << lineNumber << ":" << columnNumber << ": " << message;
-        this->message = msgStream.str();
-    }
-
-    [[nodiscard]] const char* what() const override {
-        return message.c_str();
-    }
-};
-
-struct UnknownWordError final : ParseError {
-    UnknownWordError(
-        const std::string& filePath,
-        const std::size_t lineNumber,
-        const std::size_t columnNumber,
-        const std::string& word)
-        : ParseError(filePath, lineNumber, columnNumber, "unknown word '" + word + "'") {
-    }
-};
-
-struct BadIntegerError final : ParseError {
-    BadIntegerError(
-        const std::string& filePath,
-        const std::size_t lineNumber,
-        const std::size_t columnNumber,
-        const std::string& word)
-        : ParseError(filePath, lineNumber, columnNumber, "attempt to convert to int64_t failed: " + word) {
-    }
-};
-
-porth::Op parseTokenAsOp(const porth::Token& token) {
-    static_assert(porth::TokenIds::Count.discriminant == 2, "Exhaustive token handling in parseTokenAsOp");
-    const auto& [kind, filePath, row, col, word] = token;
-    if (kind == porth::TokenIds::Word) {
-        for (const auto& [text, id] : porth::BUILTIN_WORDS) {
-            if (word == text) {
-                return porth::Op{id, filePath, row, col};
-            }
-        }
-        throw UnknownWordError{filePath, row, col, word};
-    }
-    if (kind == porth::TokenIds::Int) {
-        std::int64_t pushArg;
-        if (std::istringstream wordStream{word}; !(wordStream >> pushArg)) {
-            throw BadIntegerError{filePath, row, col, word};
-        }
-        return porth::Op{porth::OpIds::Push, filePath, row, col, pushArg};
-    }
-
-    throw std::runtime_error{"unreachable"};
-}
-
-template <typename T> T stackPop(std::stack<T>& stack) {
-    T value = std::move(stack.top());
-    stack.pop();
-    return value;
-}
-
-std::vector<porth::Op> crossReferenceBlocks(std::vector<porth::Op>&& program) {
-    std::stack<size_t> stack;
-    static_assert(porth::OpIds::Count.discriminant == 34, "Exhaustive handling of OpIds in crossReferenceBlocks");
-    for (size_t ip = 0; ip < program.size(); ++ip) {
-        if (const porth::Op& op = program[ip]; op.id == porth::OpIds::If) {
-            stack.push(ip);
-        } else if (op.id == porth::OpIds::Else) {
-            const size_t ifIp = stackPop(stack);
-            program[ifIp].operand = static_cast<std::int64_t>(ip) + 1;
-            stack.push(ip);
-        } else if (op.id == porth::OpIds::End) {
-            if (const size_t blockIp = stackPop(stack);
-                program[blockIp].id == porth::OpIds::If || program[blockIp].id == porth::OpIds::Else) {
-                program[blockIp].operand = static_cast<std::int64_t>(ip);
-                program[ip].operand = static_cast<std::int64_t>(ip) + 1;
-            } else if (program[blockIp].id == porth::OpIds::Do) {
-                program[ip].operand = program[blockIp].operand;
-                program[blockIp].operand = static_cast<std::int64_t>(ip) + 1;
-            } else {
-                throw porth::SemanticError{"`end` can only close if and while blocks for now"};
-            }
-        } else if (op.id == porth::OpIds::While) {
-            stack.push(ip);
-        } else if (op.id == porth::OpIds::Do) {
-            const size_t whileIp = stackPop(stack);
-            program[ip].operand = static_cast<std::int64_t>(whileIp);
-            stack.push(ip);
-        }
-    }
-    return program;
-}
-
-std::vector<porth::Op> loadProgramFromFile(const std::string& inputFilePath) {
-    std::vector<porth::Op> result;
-    for (const porth::Token& token : porth::lexFile(inputFilePath)) {
-        result.emplace_back(parseTokenAsOp(token));
-    }
-    return crossReferenceBlocks(std::move(result));
+    std::cerr << "      OPTIONS:\n";
+    std::cerr << "        -r                 Run the executable once it is built\n";
+    std::cerr << "        -o <file>          Where to put the executable (default: output in the build directory)\n";
+    std::cerr << "        -cache             Reuse the executable built last time for the same program and toolchain\n";
+    std::cerr << "        -cache-dir <dir>   Like -cache, but keep the cache in <dir> (default: build-cache in the\n";
+    std::cerr << "                           build directory)\n";
+    std::cerr << "        -cache-size <n>    Evict the least recently used executables beyond n bytes (default: "
+              << porth::BUILD_CACHE_CAPACITY << ")\n";
+    std::cerr << "        -backend=<name>    elf: write a static x86-64 Linux executable directly"
+              << (ELF_BACKEND_BY_DEFAULT ? " (default)" : "") << "\n";
+    std::cerr << "                           cpp: generate C++ and build it with clang++"
+              << (ELF_BACKEND_BY_DEFAULT ? "" : " (default)") << "\n";
 }
 
 int main(const int argc, char** argv) {
@@ -278,11 +221,54 @@ int main(const int argc, char** argv) {
     }
 
     bool debugMode = false;
+    bool checkAllAccesses = false;
+    porth::OptimizationLevel optimizationLevel = porth::OptimizationLevel::O1;
+    bool dumpPasses = false;
+    std::size_t lexThreads = 1;
+    std::size_t memoryCapacity = porth::MEM_CAPACITY;
 
     while (args.size() > cursor) {
         if (args[cursor] == "-debug"sv) {
             ++cursor;
             debugMode = true;
+        } else if (args[cursor] == "-checked"sv) {
+            ++cursor;
+            checkAllAccesses = true;
+        } else if (args[cursor] == "-O0"sv) {
+            ++cursor;
+            optimizationLevel = porth::OptimizationLevel::O0;
+        } else if (args[cursor] == "-O1"sv) {
+            ++cursor;
+            optimizationLevel = porth::OptimizationLevel::O1;
+        } else if (args[cursor] == "-dump-passes"sv) {
+            ++cursor;
+            dumpPasses = true;
+        } else if (args[cursor] == "-lex-threads"sv) {
+            ++cursor;
+            if (args.size() == cursor) {
+                usage(thisProgram);
+                std::cerr << "[ERROR] no argument is provided for '-lex-threads'\n";
+                return 1;
+            }
+            const std::string_view count = args[cursor++];
+            if (const auto [end, error] = std::from_chars(count.data(), count.data() + count.size(), lexThreads);
+                error != std::errc{} || end != count.data() + count.size()) {
+                std::cerr << "[ERROR] invalid thread count '" << count << "'\n";
+                return 1;
+            }
+        } else if (args[cursor] == "-mem"sv) {
+            ++cursor;
+            if (args.size() == cursor) {
+                usage(thisProgram);
+                std::cerr << "[ERROR] no argument is provided for '-mem'\n";
+                return 1;
+            }
+            const std::string_view size = args[cursor++];
+            if (const auto [end, error] = std::from_chars(size.data(), size.data() + size.size(), memoryCapacity);
+                error != std::errc{} || end != size.data() + size.size()) {
+                std::cerr << "[ERROR] invalid memory size '" << size << "'\n";
+                return 1;
+            }
         } else {
             break;
         }
@@ -298,20 +284,154 @@ int main(const int argc, char** argv) {
             std::cerr << "[ERROR] no input file is provided for the simulation\n";
             return 1;
         }
-        const char* inputFilePath = args[cursor++];
+        const char* inputFilePathOrFlag = args[cursor++];
+        bool useCache = false;
+        std::string cacheDir;
+        bool fuseOps = true;
+        bool profileMode = false;
+        bool perfStatMode = false;
+        bool instructionMix = false;
+        porth::Profile profile;
+        porth::SimulationOptions simulationOptions;
+        simulationOptions.debugMode = debugMode;
+        simulationOptions.memoryCapacity = memoryCapacity;
+        simulationOptions.checkAllAccesses = checkAllAccesses;
+        while (inputFilePathOrFlag[0] == '-') {
+            if (const char* const flag = inputFilePathOrFlag + 1; flag == "cache"sv) {
+                useCache = true;
+            } else if (flag == "no-fuse"sv) {
+                fuseOps = false;
+            } else if (flag == "engine=stack"sv) {
+                simulationOptions.engine = porth::Engine::Stack;
+            } else if (flag == "engine=tos"sv) {
+                simulationOptions.engine = porth::Engine::CachedTop;
+            } else if (flag == "perfstat"sv) {
+                perfStatMode = true;
+            } else if (flag == "perfstat=classes"sv) {
+                perfStatMode = true;
+                instructionMix = true;
+            } else if (flag == "profile"sv) {
+                profileMode = true;
+            } else if (flag == "profile=cycles"sv) {
+                profileMode = true;
+                profile.measureTicks = true;
+            } else if (flag == "cache-dir"sv) {
+                if (args.size() == cursor) {
+                    std::cerr << "[ERROR] no argument is provided for '-cache-dir'\n";
+                    return 1;
+                }
+                useCache = true;
+                cacheDir = args[cursor++];
+            } else {
+                std::cerr << "[ERROR] unknown flag '" << inputFilePathOrFlag << "'\n";
+                return 1;
+            }
+            if (args.size() == cursor) {
+                std::cerr << "[ERROR] no input file is provided for the simulation\n";
+                return 1;
+            }
+            inputFilePathOrFlag = args[cursor++];
+        }
+        const std::string inputFilePath = inputFilePathOrFlag;
+        std::vector<porth::Op> program;
+        try {
+            if (useCache) {
+                program = porth::loadProgramCached(
+                    inputFilePath,
+                    porth::programCachePath(inputFilePath, cacheDir),
+                    lexThreads);
+            } else {
+                program = porth::loadProgramFromFile(inputFilePath, lexThreads);
+            }
+        } catch (porth::ParseError& e) {
+            std::cerr << "[ERROR] parse: " << e.what() << "\n";
+            return 1;
+        } catch (porth::SemanticError& e) {
+            std::cerr << "[ERROR] semantic: " << e.what() << "\n";
+            return 1;
+        }
+        program = porth::optimizeProgram(std::move(program), optimizationLevel, dumpPasses ? &std::cerr : nullptr);
+
+        // the instruction mix comes from a profiled run, without which counting instructions is enough
+        if (profileMode || instructionMix) {
+            simulationOptions.profile = &profile;
+        }
+        std::uint64_t executedInstructions = 0;
+        if (perfStatMode) {
+            simulationOptions.executedInstructions = &executedInstructions;
+        }
+        // the profile counts every op, which fused instructions would lump together with their neighbours
+        const porth::Bytecode bytecode =
+            porth::lowerProgram(program, fuseOps && !profileMode, checkAllAccesses ? 0 : memoryCapacity);
+        int status;
+        {
+            std::optional<porth::PerfCounters> counters;
+            if (perfStatMode) {
+                counters.emplace();
+                counters->start();
+            }
+            try {
+                status = simulateProgram(bytecode, simulationOptions);
+            } catch (porth::SimulationError& e) {
+                std::cerr << "[ERROR] " << e.what() << "\n";
+                status = 1;
+            }
+            if (perfStatMode) {
+                counters->stop();
+                if (simulationOptions.profile != nullptr) {
+                    executedInstructions = 0;
+                    for (const std::uint64_t count : profile.counts) {
+                        executedInstructions += count;
+                    }
+                }
+                // on stderr, like perf stat, so the program's own output stays clean
+                porth::writePerfStat(std::cerr, *counters, executedInstructions);
+                if (instructionMix) {
+                    porth::writeInstructionMix(std::cerr, profile, bytecode);
+                }
+            }
+        }
+        // a program that failed has still been profiled up to the failure
+        if (profileMode) {
+            const std::string reportPath = inputFilePath + ".prof";
+            const std::string stacksPath = inputFilePath + ".folded";
+            std::ofstream report{reportPath};
+            porth::writeHotLines(report, profile, bytecode);
+            std::ofstream stacks{stacksPath};
+            porth::writeCollapsedStacks(stacks, profile, bytecode, program);
+            if (!report || !stacks) {
+                std::cerr << "[ERROR] failed to write the profile to " << reportPath << " and " << stacksPath << "\n";
+                return 1;
+            }
+            std::cout << "[INFO] Wrote the hot lines to " << reportPath << " and the collapsed stacks to "
+                      << stacksPath << "\n";
+        }
+        return status;
+    } else if (subcommand == "jit"sv) {
+        if (args.size() == cursor) {
+            usage(thisProgram);
+            std::cerr << "[ERROR] no input file is provided for the JIT\n";
+            return 1;
+        }
+        const std::string inputFilePath = args[cursor++];
         std::vector<porth::Op> program;
         try {
-            program = loadProgramFromFile(inputFilePath);
-        } catch (ParseError& e) {
+            program = porth::loadProgramFromFile(inputFilePath, lexThreads);
+        } catch (porth::ParseError& e) {
             std::cerr << "[ERROR] parse: " << e.what() << "\n";
             return 1;
         } catch (porth::SemanticError& e) {
             std::cerr << "[ERROR] semantic: " << e.what() << "\n";
             return 1;
         }
+        program = porth::optimizeProgram(std::move(program), optimizationLevel, dumpPasses ? &std::cerr : nullptr);
 
+        porth::SimulationOptions simulationOptions;
+        simulationOptions.debugMode = debugMode;
+        simulationOptions.memoryCapacity = memoryCapacity;
+        simulationOptions.checkAllAccesses = checkAllAccesses;
         try {
-            simulateProgram(program, debugMode);
+            return porth::jitProgram(program, simulationOptions);
         } catch (porth::SimulationError& e) {
             std::cerr << "[ERROR] " << e.what() << "\n";
             return 1;
@@ -324,7 +444,11 @@ int main(const int argc, char** argv) {
         }
         const char* inputFilePathOrFlag = args[cursor++];
         bool runExecutable = false;
+        bool elfBackend = ELF_BACKEND_BY_DEFAULT;
         std::string outputFilePath = std::string{PROJECT_BINARY_DIR} + "/output" EXE_SUFFIX;
+        bool useCache = false;
+        std::string cacheDir = std::string{PROJECT_BINARY_DIR} + "/build-cache";
+        std::uintmax_t cacheCapacity = porth::BUILD_CACHE_CAPACITY;
         if (inputFilePathOrFlag[0] == '-') {
             while (inputFilePathOrFlag[0] == '-') {
                 if (const char* const flag = inputFilePathOrFlag + 1; flag == "r"sv) {
@@ -335,6 +459,31 @@ int main(const int argc, char** argv) {
                         return 1;
                     }
                     outputFilePath = args[cursor++];
+                } else if (flag == "cache"sv) {
+                    useCache = true;
+                } else if (flag == "cache-dir"sv) {
+                    if (args.size() == cursor) {
+                        std::cerr << "[ERROR] no argument is provided for '-cache-dir'\n";
+                        return 1;
+                    }
+                    useCache = true;
+                    cacheDir = args[cursor++];
+                } else if (flag == "cache-size"sv) {
+                    if (args.size() == cursor) {
+                        std::cerr << "[ERROR] no argument is provided for '-cache-size'\n";
+                        return 1;
+                    }
+                    const std::string_view size = args[cursor++];
+                    if (const auto [end, error] =
+                            std::from_chars(size.data(), size.data() + size.size(), cacheCapacity);
+                        error != std::errc{} || end != size.data() + size.size()) {
+                        std::cerr << "[ERROR] invalid cache size '" << size << "'\n";
+                        return 1;
+                    }
+                } else if (flag == "backend=elf"sv) {
+                    elfBackend = true;
+                } else if (flag == "backend=cpp"sv) {
+                    elfBackend = false;
                 } else {
                     std::cerr << "[ERROR] unknown flag '" << inputFilePathOrFlag << "'\n";
                     return 1;
@@ -349,21 +498,63 @@ int main(const int argc, char** argv) {
         const std::string inputFilePath = inputFilePathOrFlag;
         std::vector<porth::Op> program;
         try {
-            program = loadProgramFromFile(inputFilePath);
-        } catch (ParseError& e) {
+            program = porth::loadProgramFromFile(inputFilePath, lexThreads);
+        } catch (porth::ParseError& e) {
             std::cerr << "[ERROR] parse: " << e.what() << "\n";
             return 1;
         } catch (porth::SemanticError& e) {
             std::cerr << "[ERROR] semantic: " << e.what() << "\n";
             return 1;
         }
-
-        const std::string cppOutputFilePath = std::string{PROJECT_BINARY_DIR} + "/output.cpp";
-        if (const int ret = compileProgram(program, cppOutputFilePath); ret != 0) {
-            return ret;
+        program = porth::optimizeProgram(std::move(program), optimizationLevel, dumpPasses ? &std::cerr : nullptr);
+
+        std::vector<std::string> toolchain{
+            elfBackend ? "elf" : "cpp",
+            std::to_string(memoryCapacity),
+            checkAllAccesses ? "checked" : "proven",
+        };
+        if (!elfBackend) {
+            toolchain.push_back(porth::compilerStamp(COMPILER));
+            toolchain.push_back(porth::hostCpuStamp());
+            toolchain.insert(toolchain.end(), COMPILE_FLAGS.begin(), COMPILE_FLAGS.end());
+            toolchain.insert(toolchain.end(), LINK_FLAGS.begin(), LINK_FLAGS.end());
         }
-        if (const int ret = tryBuild(cppOutputFilePath, outputFilePath); ret != 0) {
-            return ret;
+        const std::string cacheKey = useCache ? porth::buildCacheKey(program, toolchain) : "";
+        if (useCache && porth::fetchCachedBuild(cacheDir, cacheKey, outputFilePath)) {
+            std::cout << "[INFO] Reused the cached executable " << cacheKey << "\n";
+        } else {
+            // Built under names of its own, so that concurrent builds neither compile each other's source nor add each
+            // other's executable to the cache, and renamed over the output, which may be a hard link to a cache entry.
+            const std::string buildPath = porth::temporaryPath(outputFilePath).string();
+            if (elfBackend) {
+                if (const int ret = porth::writeElfExecutable(program, buildPath, memoryCapacity, checkAllAccesses);
+                    ret != 0) {
+                    return ret;
+                }
+            } else {
+                const std::string cppOutputFilePath =
+                    porth::temporaryPath(std::string{PROJECT_BINARY_DIR} + "/output").string() + ".cpp";
+                if (const int ret = compileProgram(program, cppOutputFilePath, memoryCapacity, checkAllAccesses);
+                    ret != 0) {
+                    return ret;
+                }
+                if (const int ret = tryBuild(cppOutputFilePath, buildPath); ret != 0) {
+                    return ret;
+                }
+                std::error_code error;
+                std::filesystem::remove(cppOutputFilePath, error);
+            }
+            if (useCache && !porth::storeCachedBuild(cacheDir, cacheKey, buildPath, cacheCapacity)) {
+                std::cerr << "[WARN] failed to add the executable to the build cache in " << cacheDir << "\n";
+            }
+            std::error_code error;
+            std::filesystem::rename(buildPath, outputFilePath, error);
+            if (error) {
+                std::cerr << "[ERROR] failed to move the executable to '" << outputFilePath << "': " << error.message()
+                          << "\n";
+                std::filesystem::remove(buildPath, error);
+                return 1;
+            }
         }
         if (runExecutable) {
             if (const int ret = tryRunExecutable(outputFilePath, args.subspan(cursor)); ret != 0) {
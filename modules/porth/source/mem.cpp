@@ -0,0 +1,59 @@
+#include "porth/mem.hpp"
+
+#include "porth/simulation_error.hpp"
+
+#include <sstream>
+
+#ifdef _WIN32
+#include <cstdlib>
+#else
+#include <sys/mman.h>
+#endif
+
+[[noreturn]] void throwAllocationFailure(const std::size_t capacity) {
+    std::ostringstream errorMessage;
+    errorMessage << "failed to allocate " << capacity << " bytes of memory";
+    throw porth::SimulationError{errorMessage.str()};
+}
+
+#ifdef _WIN32
+porth::Memory::Memory(const std::size_t capacity) : capacity(capacity) {
+    if (capacity > 0) {
+        bytes = static_cast<std::uint8_t*>(std::calloc(capacity, 1));
+        if (bytes == nullptr) {
+            throwAllocationFailure(capacity);
+        }
+    }
+}
+
+porth::Memory::~Memory() {
+    std::free(bytes);
+}
+#else
+porth::Memory::Memory(const std::size_t capacity) : capacity(capacity) {
+    // mmap rejects empty mappings, and a program without memory has nothing to point into anyway.
+    if (capacity > 0) {
+        // MAP_NORESERVE: a large arena that is mostly left untouched should not need swap to back it.
+        void* mapping =
+            mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mapping == MAP_FAILED) {
+            throwAllocationFailure(capacity);
+        }
+        bytes = static_cast<std::uint8_t*>(mapping);
+    }
+}
+
+porth::Memory::~Memory() {
+    if (bytes != nullptr) {
+        munmap(bytes, capacity);
+    }
+}
+#endif
+
+std::uint8_t* porth::Memory::data() const {
+    return bytes;
+}
+
+std::size_t porth::Memory::size() const {
+    return capacity;
+}
@@ -0,0 +1,183 @@
+#include "porth/native_code.hpp"
+
+#include "porth/range_analysis.hpp"
+#include "porth/stack_analysis.hpp"
+
+namespace OpIds = porth::OpIds;
+using porth::AluOp;
+using porth::Condition;
+using porth::Mem;
+using porth::Reg;
+
+constexpr Mem TOP{Reg::Rbx, -8};
+constexpr Mem SECOND{Reg::Rbx, -16};
+
+struct Stub {
+    porth::Label label;
+    std::size_t ip;
+    porth::NativeFailure failure;
+};
+
+// Binary op on the two values on top, leaving the result in place of the lower one.
+void binary(porth::Assembler& a, const AluOp op) {
+    a.mov(Reg::Rax, TOP);
+    a.alu(AluOp::Sub, Reg::Rbx, 8);
+    a.alu(op, TOP, Reg::Rax);
+}
+
+void compare(porth::Assembler& a, const Condition condition) {
+    a.mov(Reg::Rax, TOP);
+    a.alu(AluOp::Sub, Reg::Rbx, 8);
+    a.alu(AluOp::Xor, Reg::Rcx, Reg::Rcx);
+    a.alu(AluOp::Cmp, TOP, Reg::Rax);
+    a.setcc(condition, Reg::Rcx);
+    a.mov(TOP, Reg::Rcx);
+}
+
+void porth::emitProgram(
+    Assembler& a,
+    const std::vector<Op>& program,
+    NativeRuntime& runtime,
+    const bool checkStack,
+    const std::size_t provenMemory) {
+    static_assert(OpIds::Count.discriminant == 34, "Exhaustive handling of OpIds in emitProgram");
+    const std::vector<bool> proven =
+        provenMemory > 0 ? provenAccesses(program, provenMemory) : std::vector<bool>(program.size());
+    // the code for each op, and for the end of the program
+    std::vector<Label> labels;
+    labels.reserve(program.size() + 1);
+    for (std::size_t ip = 0; ip <= program.size(); ++ip) {
+        labels.push_back(a.newLabel());
+    }
+    std::vector<Stub> stubs;
+    const auto failIf = [&](const Condition condition, const std::size_t ip, const NativeFailure failure) {
+        stubs.push_back({a.newLabel(), ip, failure});
+        a.jump(condition, stubs.back().label);
+    };
+
+    for (std::size_t ip = 0; ip < program.size(); ++ip) {
+        const Op& op = program[ip];
+        a.bind(labels[ip]);
+        if (checkStack) {
+            const StackEffect effect = stackEffect(op.id);
+            if (effect.inputs > 0) {
+                a.lea(Reg::Rax, Mem{Reg::R14, static_cast<std::int32_t>(8 * effect.inputs)});
+                a.alu(AluOp::Cmp, Reg::Rbx, Reg::Rax);
+                failIf(Condition::Below, ip, NativeFailure::StackUnderflow);
+            }
+            if (effect.outputs > effect.inputs) {
+                a.lea(Reg::Rax, Mem{Reg::Rbx, static_cast<std::int32_t>(8 * (effect.outputs - effect.inputs))});
+                a.alu(AluOp::Cmp, Reg::Rax, Reg::Rbp);
+                failIf(Condition::Above, ip, NativeFailure::StackOverflow);
+            }
+        }
+        if (op.id == OpIds::Push || op.id == OpIds::Mem) {
+            const std::int64_t value = op.id == OpIds::Push ? op.operand : 0;
+            if (value == static_cast<std::int32_t>(value)) {
+                a.mov(Mem{Reg::Rbx}, static_cast<std::int32_t>(value));
+            } else {
+                a.mov(Reg::Rax, value);
+                a.mov(Mem{Reg::Rbx}, Reg::Rax);
+            }
+            a.alu(AluOp::Add, Reg::Rbx, 8);
+        } else if (op.id == OpIds::Plus) {
+            binary(a, AluOp::Add);
+        } else if (op.id == OpIds::Minus) {
+            binary(a, AluOp::Sub);
+        } else if (op.id == OpIds::Bor) {
+            binary(a, AluOp::Or);
+        } else if (op.id == OpIds::Band) {
+            binary(a, AluOp::And);
+        } else if (op.id == OpIds::Eq) {
+            compare(a, Condition::Equal);
+        } else if (op.id == OpIds::Ne) {
+            compare(a, Condition::NotEqual);
+        } else if (op.id == OpIds::Gt) {
+            compare(a, Condition::Greater);
+        } else if (op.id == OpIds::Lt) {
+            compare(a, Condition::Less);
+        } else if (op.id == OpIds::Ge) {
+            compare(a, Condition::GreaterEqual);
+        } else if (op.id == OpIds::Le) {
+            compare(a, Condition::LessEqual);
+        } else if (op.id == OpIds::Shl || op.id == OpIds::Shr) {
+            a.mov(Reg::Rcx, TOP);
+            a.alu(AluOp::Sub, Reg::Rbx, 8);
+            if (op.id == OpIds::Shl) {
+                a.shlCl(TOP);
+            } else {
+                // arithmetic, like >> on std::int64_t
+                a.sarCl(TOP);
+            }
+        } else if (op.id == OpIds::Mod) {
+            a.mov(Reg::Rcx, TOP);
+            a.alu(AluOp::Sub, Reg::Rbx, 8);
+            a.mov(Reg::Rax, TOP);
+            a.cqo();
+            a.idiv(Reg::Rcx);
+            a.mov(TOP, Reg::Rdx);
+        } else if (op.id == OpIds::If || op.id == OpIds::Do) {
+            a.alu(AluOp::Sub, Reg::Rbx, 8);
+            a.alu(AluOp::Cmp, Mem{Reg::Rbx}, 0);
+            a.jump(Condition::Equal, labels[static_cast<std::size_t>(op.operand)]);
+        } else if (op.id == OpIds::Else || op.id == OpIds::End) {
+            if (op.operand != static_cast<std::int64_t>(ip) + 1) {
+                a.jump(labels[static_cast<std::size_t>(op.operand)]);
+            }
+        } else if (op.id == OpIds::While) {
+            // nothing. just an anchor for the condition.
+        } else if (op.id == OpIds::Print) {
+            runtime.print(a, ip);
+        } else if (op.id == OpIds::Dup) {
+            a.mov(Reg::Rax, TOP);
+            a.mov(Mem{Reg::Rbx}, Reg::Rax);
+            a.alu(AluOp::Add, Reg::Rbx, 8);
+        } else if (op.id == OpIds::Dup2) {
+            a.mov(Reg::Rax, SECOND);
+            a.mov(Reg::Rcx, TOP);
+            a.mov(Mem{Reg::Rbx}, Reg::Rax);
+            a.mov(Mem{Reg::Rbx, 8}, Reg::Rcx);
+            a.alu(AluOp::Add, Reg::Rbx, 16);
+        } else if (op.id == OpIds::Swap) {
+            a.mov(Reg::Rax, TOP);
+            a.mov(Reg::Rcx, SECOND);
+            a.mov(SECOND, Reg::Rax);
+            a.mov(TOP, Reg::Rcx);
+        } else if (op.id == OpIds::Over) {
+            a.mov(Reg::Rax, SECOND);
+            a.mov(Mem{Reg::Rbx}, Reg::Rax);
+            a.alu(AluOp::Add, Reg::Rbx, 8);
+        } else if (op.id == OpIds::Drop) {
+            a.alu(AluOp::Sub, Reg::Rbx, 8);
+        } else if (op.id == OpIds::Load) {
+            a.mov(Reg::Rax, TOP);
+            if (!proven[ip]) {
+                a.alu(AluOp::Cmp, Reg::Rax, Reg::R15);
+                failIf(Condition::AboveEqual, ip, NativeFailure::Load);
+            }
+            a.movzxByte(Reg::Rax, Mem{Reg::R12, 0, Reg::Rax});
+            a.mov(TOP, Reg::Rax);
+        } else if (op.id == OpIds::Store) {
+            a.mov(Reg::Rax, SECOND);
+            a.mov(Reg::Rcx, TOP);
+            a.alu(AluOp::Sub, Reg::Rbx, 16);
+            if (!proven[ip]) {
+                a.alu(AluOp::Cmp, Reg::Rax, Reg::R15);
+                failIf(Condition::AboveEqual, ip, NativeFailure::Store);
+            }
+            a.movByte(Mem{Reg::R12, 0, Reg::Rax}, Reg::Rcx);
+        } else if (
+            op.id == OpIds::Syscall1 || op.id == OpIds::Syscall2 || op.id == OpIds::Syscall3 ||
+            op.id == OpIds::Syscall4 || op.id == OpIds::Syscall5 || op.id == OpIds::Syscall6) {
+            runtime.syscall(a, ip, stackEffect(op.id).inputs - 1);
+        }
+    }
+    a.bind(labels[program.size()]);
+    runtime.finish(a);
+
+    // Errors are rare, so their code stays out of the way of the ops.
+    for (const Stub& stub : stubs) {
+        a.bind(stub.label);
+        runtime.fail(a, stub.ip, stub.failure);
+    }
+}
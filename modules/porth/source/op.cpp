@@ -2,19 +2,13 @@
 
 #include "iota_generated/op_id.hpp"
 
-porth::Op::Op(const OpId id, std::string filePath, const std::size_t lineNumber, const std::size_t columnNumber)
-    : Op(id, std::move(filePath), lineNumber, columnNumber, 0) {
+porth::Op::Op(const OpId id, const LocationId location) : Op(id, location, 0) {
 }
 
-porth::Op::Op(
-    const OpId id,
-    std::string filePath,
-    const std::size_t lineNumber,
-    const std::size_t columnNumber,
-    const std::int64_t operand)
-    : id(id), filePath(std::move(filePath)), lineNumber(lineNumber), columnNumber(columnNumber), operand(operand) {
+porth::Op::Op(const OpId id, const LocationId location, const std::int64_t operand)
+    : id(id), location(location), operand(operand) {
 }
 
 std::ostream& operator<<(std::ostream& os, const porth::Op& op) {
-    return os << op.id.name;
+    return os << op.id.name();
 }
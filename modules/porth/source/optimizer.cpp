@@ -0,0 +1,295 @@
+#include "porth/optimizer.hpp"
+
+#include "porth/source_map.hpp"
+#include "porth/stack_analysis.hpp"
+
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <optional>
+
+namespace OpIds = porth::OpIds;
+
+bool jumps(const porth::Op& op) {
+    return op.id == OpIds::If || op.id == OpIds::Else || op.id == OpIds::End || op.id == OpIds::Do;
+}
+
+// Which ops some jump lands on, with one more entry for the end of the program.
+std::vector<bool> jumpTargets(const std::vector<porth::Op>& program) {
+    std::vector<bool> targets(program.size() + 1);
+    for (const porth::Op& op : program) {
+        if (jumps(op)) {
+            targets[static_cast<std::size_t>(op.operand)] = true;
+        }
+    }
+    return targets;
+}
+
+// Drops the removed ops and renumbers the jumps. A jump that landed on a removed op lands on the next op kept.
+std::vector<porth::Op> compact(const std::vector<porth::Op>& program, const std::vector<bool>& removed) {
+    std::vector<std::size_t> index(program.size() + 1);
+    std::size_t kept = 0;
+    for (std::size_t ip = 0; ip < program.size(); ++ip) {
+        index[ip] = kept;
+        if (!removed[ip]) {
+            ++kept;
+        }
+    }
+    index[program.size()] = kept;
+
+    std::vector<porth::Op> result;
+    result.reserve(kept);
+    for (std::size_t ip = 0; ip < program.size(); ++ip) {
+        if (removed[ip]) {
+            continue;
+        }
+        porth::Op op = program[ip];
+        if (jumps(op)) {
+            op.operand = static_cast<std::int64_t>(index[static_cast<std::size_t>(op.operand)]);
+        }
+        result.push_back(op);
+    }
+    return result;
+}
+
+// The value the op pushes, if it pushes one known ahead of time. mem is the address 0.
+std::optional<std::int64_t> literal(const porth::Op& op) {
+    if (op.id == OpIds::Push) {
+        return op.operand;
+    }
+    if (op.id == OpIds::Mem) {
+        return 0;
+    }
+    return std::nullopt;
+}
+
+// What the op leaves for a and b, if that is the same on every run. Arithmetic wraps around like it does at run time;
+// shifts out of range and remainders that trap are left for run time.
+std::optional<std::int64_t> evaluate(const porth::OpId id, const std::int64_t a, const std::int64_t b) {
+    const auto ua = static_cast<std::uint64_t>(a);
+    const auto ub = static_cast<std::uint64_t>(b);
+    if (id == OpIds::Plus) {
+        return static_cast<std::int64_t>(ua + ub);
+    }
+    if (id == OpIds::Minus) {
+        return static_cast<std::int64_t>(ua - ub);
+    }
+    if (id == OpIds::Eq) {
+        return a == b ? 1 : 0;
+    }
+    if (id == OpIds::Ne) {
+        return a != b ? 1 : 0;
+    }
+    if (id == OpIds::Gt) {
+        return a > b ? 1 : 0;
+    }
+    if (id == OpIds::Lt) {
+        return a < b ? 1 : 0;
+    }
+    if (id == OpIds::Ge) {
+        return a >= b ? 1 : 0;
+    }
+    if (id == OpIds::Le) {
+        return a <= b ? 1 : 0;
+    }
+    if (id == OpIds::Bor) {
+        return a | b;
+    }
+    if (id == OpIds::Band) {
+        return a & b;
+    }
+    if ((id == OpIds::Shl || id == OpIds::Shr) && b >= 0 && b <= 63) {
+        return id == OpIds::Shl ? static_cast<std::int64_t>(ua << b) : a >> b;
+    }
+    if (id == OpIds::Mod && b != 0 && !(a == std::numeric_limits<std::int64_t>::min() && b == -1)) {
+        return a % b;
+    }
+    return std::nullopt;
+}
+
+std::vector<porth::Op> foldConstants(std::vector<porth::Op> program) {
+    const std::vector<bool> targets = jumpTargets(program);
+    std::vector<bool> removed(program.size());
+    // The literals that the ops kept so far end with, which are on the stack whenever the next op runs. A fold leaves
+    // its result in place of the first of them, where the next op can fold it again, as in `1 2 + 3 +`.
+    std::vector<std::size_t> literals;
+    for (std::size_t ip = 0; ip < program.size(); ++ip) {
+        if (targets[ip]) {
+            // a jump may land here with anything on the stack
+            literals.clear();
+        }
+        if (literal(program[ip])) {
+            literals.push_back(ip);
+            continue;
+        }
+        if (literals.size() >= 2) {
+            const std::size_t a = literals[literals.size() - 2];
+            const std::size_t b = literals.back();
+            if (const std::optional<std::int64_t> result =
+                    evaluate(program[ip].id, *literal(program[a]), *literal(program[b]))) {
+                program[a] = porth::Op{OpIds::Push, program[a].location, *result};
+                removed[b] = true;
+                removed[ip] = true;
+                literals.pop_back();
+                continue;
+            }
+        }
+        literals.clear();
+    }
+    return compact(program, removed);
+}
+
+// Blocks nest, so removing the whole of an if or a loop, or just its keywords, leaves the rest of them balanced.
+std::vector<porth::Op> foldBranches(const std::vector<porth::Op>& program) {
+    const std::vector<bool> targets = jumpTargets(program);
+    std::vector<bool> removed(program.size());
+    const auto remove = [&](const std::size_t first, const std::size_t last) {
+        for (std::size_t ip = first; ip <= last; ++ip) {
+            removed[ip] = true;
+        }
+    };
+    for (std::size_t ip = 0; ip + 1 < program.size(); ++ip) {
+        const std::optional<std::int64_t> condition = literal(program[ip]);
+        const porth::Op& branch = program[ip + 1];
+        if (!condition || removed[ip] || targets[ip + 1] || (branch.id != OpIds::If && branch.id != OpIds::Do)) {
+            continue;
+        }
+        const auto target = static_cast<std::size_t>(branch.operand);
+        if (branch.id == OpIds::If) {
+            // if jumps past its else when there is one, and to its end otherwise
+            const bool hasElse = program[target - 1].id == OpIds::Else && target - 1 > ip + 1;
+            const std::size_t end = hasElse ? static_cast<std::size_t>(program[target - 1].operand) : target;
+            if (*condition != 0) {
+                remove(ip, ip + 1);
+                remove(hasElse ? target - 1 : end, end);
+            } else {
+                remove(ip, hasElse ? target - 1 : end);
+                removed[end] = true;
+            }
+        } else {
+            // do jumps past the end, which jumps back to the while
+            const std::size_t end = target - 1;
+            if (*condition != 0) {
+                // a loop only an exit syscall gets out of
+                remove(ip, ip + 1);
+            } else {
+                // the condition runs once, and nothing jumps back to the while any more
+                removed[static_cast<std::size_t>(program[end].operand)] = true;
+                remove(ip, end);
+            }
+        }
+        ++ip;
+    }
+    return compact(program, removed);
+}
+
+bool cancels(const porth::Op& first, const porth::Op& second) {
+    if (second.id == OpIds::Drop) {
+        return first.id == OpIds::Dup || first.id == OpIds::Over || literal(first).has_value();
+    }
+    if (first.id == OpIds::Swap) {
+        return second.id == OpIds::Swap;
+    }
+    return literal(first) == 0 && (second.id == OpIds::Plus || second.id == OpIds::Minus || second.id == OpIds::Bor ||
+                                   second.id == OpIds::Shl || second.id == OpIds::Shr);
+}
+
+// Dropping ops is only safe once every op is known to find enough values on the stack: otherwise the ops dropped
+// could be the ones that report an underflow.
+std::vector<porth::Op> removeNoOps(std::vector<porth::Op> program) {
+    if (!porth::stackDepths(program)) {
+        return program;
+    }
+    // removing a pair can bring together another pair, like in `swap dup drop swap`
+    for (bool changed = true; changed;) {
+        changed = false;
+        const std::vector<bool> targets = jumpTargets(program);
+        std::vector<bool> removed(program.size());
+        for (std::size_t ip = 0; ip + 1 < program.size(); ++ip) {
+            if (targets[ip + 1]) {
+                continue;
+            }
+            std::size_t length = 0;
+            if (cancels(program[ip], program[ip + 1])) {
+                length = 2;
+            } else if (
+                ip + 2 < program.size() && !targets[ip + 2] && program[ip].id == OpIds::Dup2 &&
+                program[ip + 1].id == OpIds::Drop && program[ip + 2].id == OpIds::Drop) {
+                length = 3;
+            }
+            if (length > 0) {
+                for (std::size_t i = 0; i < length; ++i) {
+                    removed[ip + i] = true;
+                }
+                changed = true;
+                ip += length - 1;
+            }
+        }
+        program = compact(program, removed);
+    }
+    return program;
+}
+
+std::vector<porth::Op> removeUnreachable(const std::vector<porth::Op>& program) {
+    std::vector<bool> reached(program.size());
+    std::vector<std::size_t> pending;
+    const auto reach = [&](const std::size_t ip) {
+        if (ip < program.size() && !reached[ip]) {
+            reached[ip] = true;
+            pending.push_back(ip);
+        }
+    };
+    reach(0);
+    while (!pending.empty()) {
+        const std::size_t ip = pending.back();
+        pending.pop_back();
+        const porth::Op& op = program[ip];
+        if (jumps(op)) {
+            reach(static_cast<std::size_t>(op.operand));
+        }
+        if (op.id != OpIds::Else && op.id != OpIds::End) {
+            reach(ip + 1);
+        }
+    }
+    std::vector<bool> removed(program.size());
+    for (std::size_t ip = 0; ip < program.size(); ++ip) {
+        removed[ip] = !reached[ip];
+    }
+    return compact(program, removed);
+}
+
+void dumpProgram(std::ostream& output, const char* const pass, const std::vector<porth::Op>& program) {
+    output << "[INFO] After " << pass << ": " << program.size() << " ops\n";
+    for (std::size_t ip = 0; ip < program.size(); ++ip) {
+        const porth::Op& op = program[ip];
+        output << std::setw(8) << ip << "  " << op.id.name();
+        if (op.id == OpIds::Push || jumps(op)) {
+            output << " " << op.operand;
+        }
+        output << "  " << porth::sourceMap().resolve(op.location) << "\n";
+    }
+}
+
+std::vector<porth::Op> porth::optimizeProgram(
+    std::vector<Op> program, const OptimizationLevel level, std::ostream* const dump) {
+    if (level == OptimizationLevel::O0) {
+        return program;
+    }
+    struct Pass {
+        const char* name;
+        std::vector<Op> (*run)(std::vector<Op>);
+    };
+    constexpr Pass PASSES[] = {
+        {"fold-constants", foldConstants},
+        {"fold-branches", [](std::vector<Op> p) { return foldBranches(p); }},
+        {"remove-no-ops", removeNoOps},
+        {"remove-unreachable", [](std::vector<Op> p) { return removeUnreachable(p); }},
+    };
+    for (const Pass& pass : PASSES) {
+        program = pass.run(std::move(program));
+        if (dump != nullptr) {
+            dumpProgram(*dump, pass.name, program);
+        }
+    }
+    return program;
+}
@@ -0,0 +1,99 @@
+#include "porth/output.hpp"
+
+#include "porth/simulation_error.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <sstream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+[[noreturn]] void throwWriteFailure(const int fd) {
+    std::ostringstream errorMessage;
+    errorMessage << "failed to write to file descriptor " << fd;
+    throw porth::SimulationError{errorMessage.str()};
+}
+
+void writeAll(const int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        const auto written = _write(fd, data, static_cast<unsigned int>(std::min<std::size_t>(size, 1 << 30)));
+#else
+        const auto written = ::write(fd, data, size);
+#endif
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throwWriteFailure(fd);
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+}
+
+porth::OutputChannel::~OutputChannel() {
+    try {
+        flush();
+    } catch (const SimulationError&) {
+        // nowhere left to report it
+    }
+}
+
+void porth::OutputChannel::flush() {
+    // reset first, so a failed flush is not retried from the destructor
+    const std::size_t size = used;
+    used = 0;
+    writeAll(pendingFd, buffer.data(), size);
+}
+
+void porth::OutputChannel::switchTo(const int fd) {
+    flush();
+    pendingFd = fd;
+}
+
+void porth::OutputChannel::writeSlow(const int fd, const std::string_view bytes) {
+    if (fd != pendingFd) {
+        flush();
+        pendingFd = fd;
+    }
+    if (bytes.size() <= CAPACITY - used && fd != 2) {
+        std::memcpy(buffer.data() + used, bytes.data(), bytes.size());
+        used += bytes.size();
+        return;
+    }
+#ifndef _WIN32
+    // Send the pending bytes and the new ones in one call instead of copying the new ones through the buffer.
+    if (used > 0) {
+        iovec parts[] = {
+            {buffer.data(), used},
+            {const_cast<char*>(bytes.data()), bytes.size()},
+        };
+        const std::size_t pending = used;
+        used = 0;
+        ssize_t written;
+        do {
+            written = writev(fd, parts, 2);
+        } while (written < 0 && errno == EINTR);
+        if (written < 0) {
+            throwWriteFailure(fd);
+        }
+        // writev may stop short, in which case the rest goes out with plain writes
+        const auto done = static_cast<std::size_t>(written);
+        if (done < pending) {
+            writeAll(fd, buffer.data() + done, pending - done);
+            writeAll(fd, bytes.data(), bytes.size());
+        } else {
+            writeAll(fd, bytes.data() + (done - pending), bytes.size() - (done - pending));
+        }
+        return;
+    }
+#endif
+    flush();
+    writeAll(fd, bytes.data(), bytes.size());
+}
@@ -0,0 +1,22 @@
+#include "porth/parse_error.hpp"
+
+#include <sstream>
+
+porth::ParseError::ParseError(const SourceLocation& location, const std::string& message)
+    : std::runtime_error(message) {
+    std::ostringstream msgStream;
+    msgStream << location << ": " << message;
+    this->message = msgStream.str();
+}
+
+const char* porth::ParseError::what() const noexcept {
+    return message.c_str();
+}
+
+porth::UnknownWordError::UnknownWordError(const SourceLocation& location, const std::string_view word)
+    : ParseError(location, "unknown word '" + std::string{word} + "'") {
+}
+
+porth::BadIntegerError::BadIntegerError(const SourceLocation& location, const std::string_view word)
+    : ParseError(location, "attempt to convert to int64_t failed: " + std::string{word}) {
+}
@@ -0,0 +1,98 @@
+#include "porth/parser.hpp"
+
+#include "porth/parse_error.hpp"
+#include "porth/semantic_error.hpp"
+
+#include <optional>
+#include <sstream>
+
+porth::Op porth::parseTokenAsOp(const Token& token) {
+    static_assert(TokenIds::Count.discriminant == 2, "Exhaustive token handling in parseTokenAsOp");
+    const auto& [kind, location, word, value] = token;
+    if (kind == TokenIds::Word) {
+        if (const std::optional<OpId> id = OpIds::fromSpelling(word)) {
+            return Op{*id, location};
+        }
+        throw UnknownWordError{sourceMap().resolve(location), word};
+    }
+    if (kind == TokenIds::Int) {
+        return Op{OpIds::Push, location, value};
+    }
+
+    throw std::runtime_error{"unreachable"};
+}
+
+[[noreturn]] void throwBlockError(const porth::Op& op, const std::string& message) {
+    std::ostringstream errorMessage;
+    errorMessage << porth::sourceMap().resolve(op.location) << ": " << message;
+    throw porth::SemanticError{errorMessage.str()};
+}
+
+void porth::BlockResolver::resolve(std::vector<Op>& program, const std::size_t ip) {
+    static_assert(OpIds::Count.discriminant == 34, "Exhaustive handling of OpIds in BlockResolver::resolve");
+    const Op& op = program[ip];
+    if (op.id == OpIds::If || op.id == OpIds::While) {
+        stack.push_back(ip);
+    } else if (op.id == OpIds::Else) {
+        if (stack.empty() || program[stack.back()].id != OpIds::If) {
+            throwBlockError(op, "`else` can only be used in `if` blocks");
+        }
+        program[stack.back()].operand = static_cast<std::int64_t>(ip) + 1;
+        stack.back() = ip;
+    } else if (op.id == OpIds::End) {
+        if (stack.empty()) {
+            throwBlockError(op, "`end` does not close any block");
+        }
+        const std::size_t blockIp = stack.back();
+        stack.pop_back();
+        if (program[blockIp].id == OpIds::If || program[blockIp].id == OpIds::Else) {
+            program[blockIp].operand = static_cast<std::int64_t>(ip);
+            program[ip].operand = static_cast<std::int64_t>(ip) + 1;
+        } else if (program[blockIp].id == OpIds::Do) {
+            program[ip].operand = program[blockIp].operand;
+            program[blockIp].operand = static_cast<std::int64_t>(ip) + 1;
+        } else {
+            throwBlockError(op, "`end` can only close if and while blocks for now");
+        }
+    } else if (op.id == OpIds::Do) {
+        if (stack.empty() || program[stack.back()].id != OpIds::While) {
+            throwBlockError(op, "`do` can only be used in `while` blocks");
+        }
+        program[ip].operand = static_cast<std::int64_t>(stack.back());
+        stack.back() = ip;
+    }
+}
+
+void porth::BlockResolver::finish(const std::vector<Op>& program) const {
+    if (!stack.empty()) {
+        throwBlockError(program[stack.back()], "block is not closed with `end`");
+    }
+}
+
+void porth::crossReferenceBlocks(std::vector<Op>& program) {
+    BlockResolver resolver;
+    for (std::size_t ip = 0; ip < program.size(); ++ip) {
+        resolver.resolve(program, ip);
+    }
+    resolver.finish(program);
+}
+
+std::vector<porth::Op> porth::loadProgramFromFile(const std::string& inputFilePath, const std::size_t lexThreads) {
+    std::vector<Op> program;
+    BlockResolver resolver;
+    if (lexThreads != 1) {
+        lexFileParallel(inputFilePath, lexThreads, ScanMode::Scalar, [&](const Token& token) {
+            program.push_back(parseTokenAsOp(token));
+            resolver.resolve(program, program.size() - 1);
+        });
+        resolver.finish(program);
+        return program;
+    }
+    Lexer lexer{inputFilePath};
+    while (const std::optional<Token> token = lexer.next()) {
+        program.push_back(parseTokenAsOp(*token));
+        resolver.resolve(program, program.size() - 1);
+    }
+    resolver.finish(program);
+    return program;
+}
@@ -0,0 +1,273 @@
+#include "porth/perf_counters.hpp"
+
+#include <iomanip>
+#include <string_view>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using porth::PerfEvent;
+
+constexpr std::size_t EVENT_COUNT = static_cast<std::size_t>(PerfEvent::Count);
+
+constexpr std::string_view EVENT_NAMES[EVENT_COUNT] = {
+    "task-clock (ns)",
+    "instructions",
+    "cycles",
+    "branches",
+    "branch-misses",
+    "L1-dcache-load-misses",
+    "LLC-load-misses",
+};
+
+#ifdef __linux__
+perf_event_attr eventAttributes(const PerfEvent event) {
+    perf_event_attr attributes{};
+    attributes.size = sizeof attributes;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    constexpr std::uint64_t READ_MISS = PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+    switch (event) {
+    case PerfEvent::TaskClock:
+        attributes.type = PERF_TYPE_SOFTWARE;
+        attributes.config = PERF_COUNT_SW_TASK_CLOCK;
+        break;
+    case PerfEvent::Instructions:
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case PerfEvent::Cycles:
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case PerfEvent::Branches:
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS;
+        break;
+    case PerfEvent::BranchMisses:
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    case PerfEvent::L1DataMisses:
+        attributes.type = PERF_TYPE_HW_CACHE;
+        attributes.config = PERF_COUNT_HW_CACHE_L1D | READ_MISS;
+        break;
+    case PerfEvent::LastLevelMisses:
+        attributes.type = PERF_TYPE_HW_CACHE;
+        attributes.config = PERF_COUNT_HW_CACHE_LL | READ_MISS;
+        break;
+    case PerfEvent::Count:
+        break;
+    }
+    return attributes;
+}
+
+porth::PerfCounters::PerfCounters() {
+    fds.fill(-1);
+    for (std::size_t i = 0; i < EVENT_COUNT; ++i) {
+        perf_event_attr attributes = eventAttributes(static_cast<PerfEvent>(i));
+        // this thread, on any CPU, on its own rather than in a group, so one missing event does not take the rest
+        fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+        if (fds[i] < 0 && unavailableReason.empty()) {
+            unavailableReason = std::strerror(errno);
+            if (errno == EACCES || errno == EPERM) {
+                unavailableReason += " (see /proc/sys/kernel/perf_event_paranoid)";
+            } else if (errno == ENOENT || errno == ENODEV || errno == EOPNOTSUPP) {
+                unavailableReason += " (the host exposes no such counter, as is common in VMs and containers)";
+            }
+        }
+    }
+}
+
+porth::PerfCounters::~PerfCounters() {
+    for (const int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void porth::PerfCounters::start() {
+    for (const int fd : fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void porth::PerfCounters::stop() {
+    for (const int fd : fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+}
+
+std::optional<std::uint64_t> porth::PerfCounters::read(const PerfEvent event) const {
+    const int fd = fds[static_cast<std::size_t>(event)];
+    // value, time enabled, time running
+    std::uint64_t values[3] = {};
+    if (fd < 0 || ::read(fd, values, sizeof values) != sizeof values || values[2] == 0) {
+        return std::nullopt;
+    }
+    if (values[2] < values[1]) {
+        return static_cast<std::uint64_t>(static_cast<double>(values[0]) * values[1] / values[2]);
+    }
+    return values[0];
+}
+#else
+porth::PerfCounters::PerfCounters() : unavailableReason("perf_event_open is Linux only") {
+    fds.fill(-1);
+}
+
+porth::PerfCounters::~PerfCounters() = default;
+
+void porth::PerfCounters::start() {
+}
+
+void porth::PerfCounters::stop() {
+}
+
+std::optional<std::uint64_t> porth::PerfCounters::read(const PerfEvent /*event*/) const {
+    return std::nullopt;
+}
+#endif
+
+double ratio(const std::uint64_t numerator, const std::uint64_t denominator) {
+    return denominator == 0 ? 0 : static_cast<double>(numerator) / static_cast<double>(denominator);
+}
+
+void porth::writePerfStat(
+    std::ostream& output, const PerfCounters& counters, const std::uint64_t executedInstructions) {
+    output << "[INFO] Performance counters for " << executedInstructions << " executed instructions\n";
+    output << std::fixed << std::setprecision(2);
+    bool anyHardware = false;
+    for (std::size_t i = 0; i < EVENT_COUNT; ++i) {
+        const auto event = static_cast<PerfEvent>(i);
+        output << "  " << std::left << std::setw(24) << EVENT_NAMES[i] << std::right;
+        if (const std::optional<std::uint64_t> value = counters.read(event)) {
+            anyHardware = anyHardware || event != PerfEvent::TaskClock;
+            output << std::setw(16) << *value << std::setw(12) << ratio(*value, executedInstructions)
+                   << " per instruction\n";
+        } else {
+            output << std::setw(16) << "not counted"
+                   << "\n";
+        }
+    }
+    const std::optional<std::uint64_t> instructions = counters.read(PerfEvent::Instructions);
+    if (const std::optional<std::uint64_t> cycles = counters.read(PerfEvent::Cycles); instructions && cycles) {
+        output << "  " << std::left << std::setw(24) << "IPC" << std::right << std::setw(16)
+               << ratio(*instructions, *cycles) << "\n";
+    }
+    if (const std::optional<std::uint64_t> branches = counters.read(PerfEvent::Branches)) {
+        if (const std::optional<std::uint64_t> misses = counters.read(PerfEvent::BranchMisses)) {
+            output << "  " << std::left << std::setw(24) << "branch miss rate" << std::right << std::setw(15)
+                   << 100 * ratio(*misses, *branches) << "%\n";
+        }
+    }
+    if (!anyHardware) {
+        // the events may all have opened and still counted nothing, e.g. when the counters were never started
+        const std::string_view reason =
+            counters.unavailableReason.empty() ? "no event was counted" : std::string_view{counters.unavailableReason};
+        output << "[WARN] Hardware counters are not available: " << reason << "\n";
+    }
+}
+
+enum struct InstructionClass {
+    Stack,
+    Arithmetic,
+    Comparison,
+    ControlFlow,
+    Memory,
+    InputOutput,
+    Count,
+};
+
+constexpr std::string_view CLASS_NAMES[static_cast<std::size_t>(InstructionClass::Count)] = {
+    "stack",
+    "arithmetic",
+    "comparison",
+    "control flow",
+    "memory",
+    "input/output",
+};
+
+InstructionClass classify(const porth::Opcode opcode) {
+    using porth::Opcode;
+    static_assert(static_cast<int>(Opcode::Count) == 47, "Exhaustive handling of Opcodes in classify");
+    switch (opcode) {
+    case Opcode::Push:
+    case Opcode::Dup:
+    case Opcode::Dup2:
+    case Opcode::Swap:
+    case Opcode::Drop:
+    case Opcode::Over:
+    case Opcode::Mem:
+        return InstructionClass::Stack;
+    case Opcode::Plus:
+    case Opcode::Minus:
+    case Opcode::Shr:
+    case Opcode::Shl:
+    case Opcode::Bor:
+    case Opcode::Band:
+    case Opcode::Mod:
+    case Opcode::AddImm:
+    case Opcode::ShlImm:
+    case Opcode::ShrImm:
+    case Opcode::BandImm:
+    case Opcode::BorImm:
+        return InstructionClass::Arithmetic;
+    case Opcode::Eq:
+    case Opcode::Ne:
+    case Opcode::Gt:
+    case Opcode::Lt:
+    case Opcode::Ge:
+    case Opcode::Le:
+        return InstructionClass::Comparison;
+    case Opcode::Load:
+    case Opcode::Store:
+    case Opcode::LoadOffset:
+    case Opcode::StoreImm:
+    case Opcode::LoadUnchecked:
+    case Opcode::StoreUnchecked:
+    case Opcode::LoadOffsetUnchecked:
+    case Opcode::StoreImmUnchecked:
+        return InstructionClass::Memory;
+    case Opcode::Print:
+    case Opcode::Syscall1:
+    case Opcode::Syscall2:
+    case Opcode::Syscall3:
+    case Opcode::Syscall4:
+    case Opcode::Syscall5:
+    case Opcode::Syscall6:
+        return InstructionClass::InputOutput;
+    default:
+        return InstructionClass::ControlFlow;
+    }
+}
+
+void porth::writeInstructionMix(std::ostream& output, const Profile& profile, const Bytecode& bytecode) {
+    std::uint64_t classes[static_cast<std::size_t>(InstructionClass::Count)] = {};
+    std::uint64_t total = 0;
+    for (std::size_t at = 0; at < profile.counts.size();) {
+        const auto opcode = static_cast<Opcode>(bytecode.code[at]);
+        classes[static_cast<std::size_t>(classify(opcode))] += profile.counts[at];
+        total += profile.counts[at];
+        at += instructionSize(opcode);
+    }
+    output << "[INFO] Executed instructions by class\n";
+    output << std::fixed << std::setprecision(2);
+    for (std::size_t i = 0; i < std::size(classes); ++i) {
+        output << "  " << std::left << std::setw(24) << CLASS_NAMES[i] << std::right << std::setw(16) << classes[i]
+               << std::setw(11) << 100 * ratio(classes[i], total) << "%\n";
+    }
+}
@@ -0,0 +1,203 @@
+#include "porth/profile.hpp"
+
+#include "porth/source_file.hpp"
+#include "porth/source_map.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+namespace OpIds = porth::OpIds;
+
+const char* opcodeName(const porth::Opcode opcode) {
+    static_assert(static_cast<int>(porth::Opcode::Count) == 47, "Exhaustive handling of Opcodes in opcodeName");
+    if (static_cast<std::uint32_t>(opcode) < OpIds::Count.discriminant) {
+        return porth::OpId{static_cast<std::uint32_t>(opcode)}.name();
+    }
+    switch (opcode) {
+    case porth::Opcode::AddImm:
+        return "AddImm";
+    case porth::Opcode::ShlImm:
+        return "ShlImm";
+    case porth::Opcode::ShrImm:
+        return "ShrImm";
+    case porth::Opcode::BandImm:
+        return "BandImm";
+    case porth::Opcode::BorImm:
+        return "BorImm";
+    case porth::Opcode::LoadOffset:
+        return "LoadOffset";
+    case porth::Opcode::StoreImm:
+        return "StoreImm";
+    case porth::Opcode::DupLtImmDo:
+        return "DupLtImmDo";
+    case porth::Opcode::LoadUnchecked:
+        return "LoadUnchecked";
+    case porth::Opcode::StoreUnchecked:
+        return "StoreUnchecked";
+    case porth::Opcode::LoadOffsetUnchecked:
+        return "LoadOffsetUnchecked";
+    case porth::Opcode::StoreImmUnchecked:
+        return "StoreImmUnchecked";
+    default:
+        return "Halt";
+    }
+}
+
+// An instruction that ran at least once.
+struct Sample {
+    porth::Opcode opcode;
+    porth::LocationId location;
+    std::uint64_t count;
+    std::uint64_t ticks;
+};
+
+std::vector<Sample> collectSamples(const porth::Profile& profile, const porth::Bytecode& bytecode) {
+    std::vector<Sample> samples;
+    std::size_t instruction = 0;
+    for (std::size_t at = 0; at < profile.counts.size() && instruction < bytecode.locations.size(); ++instruction) {
+        const auto opcode = static_cast<porth::Opcode>(bytecode.code[at]);
+        if (profile.counts[at] > 0) {
+            const std::uint64_t ticks = profile.measureTicks ? profile.ticks[at] : 0;
+            samples.push_back({opcode, bytecode.locations[instruction], profile.counts[at], ticks});
+        }
+        at += porth::instructionSize(opcode);
+    }
+    return samples;
+}
+
+// What the report sorts by and the flame graph sizes frames by.
+std::uint64_t weight(const porth::Profile& profile, const std::uint64_t count, const std::uint64_t ticks) {
+    return profile.measureTicks ? ticks : count;
+}
+
+// The line of source, without its indentation, or nothing if the file cannot be read anymore.
+std::string_view sourceLine(const porth::SourceLocation& location) {
+    std::string_view contents;
+    try {
+        contents = porth::mapSourceFile(std::string{location.filePath});
+    } catch (const std::runtime_error&) {
+        return {};
+    }
+    for (std::size_t line = 1; line < location.lineNumber; ++line) {
+        const std::size_t newline = contents.find('\n');
+        if (newline == std::string_view::npos) {
+            return {};
+        }
+        contents.remove_prefix(newline + 1);
+    }
+    contents = contents.substr(0, contents.find('\n'));
+    const std::size_t first = contents.find_first_not_of(" \t");
+    const std::size_t last = contents.find_last_not_of(" \t\r");
+    return first == std::string_view::npos ? std::string_view{} : contents.substr(first, last - first + 1);
+}
+
+void writeHeader(std::ostream& output, const porth::Profile& profile) {
+    output << std::setw(14) << "count";
+    if (profile.measureTicks) {
+        output << std::setw(16) << porth::TICK_UNIT;
+    }
+    output << std::setw(9) << "share"
+           << "  location\n";
+}
+
+void writeRow(
+    std::ostream& output,
+    const porth::Profile& profile,
+    const std::uint64_t count,
+    const std::uint64_t ticks,
+    const std::uint64_t total) {
+    output << std::setw(14) << count;
+    if (profile.measureTicks) {
+        output << std::setw(16) << ticks;
+    }
+    const double share = total == 0 ? 0 : 100.0 * static_cast<double>(weight(profile, count, ticks)) / total;
+    output << std::setw(8) << std::fixed << std::setprecision(2) << share << "%  ";
+}
+
+void porth::writeHotLines(std::ostream& output, const Profile& profile, const Bytecode& bytecode) {
+    std::vector<Sample> samples = collectSamples(profile, bytecode);
+    std::uint64_t totalCount = 0;
+    std::uint64_t totalTicks = 0;
+    // keyed by file and line, so lines come out in source order among equals
+    std::map<std::tuple<std::string_view, std::size_t>, Sample> lines;
+    for (const Sample& sample : samples) {
+        totalCount += sample.count;
+        totalTicks += sample.ticks;
+        const SourceLocation location = sourceMap().resolve(sample.location);
+        const auto [line, inserted] =
+            lines.try_emplace({location.filePath, location.lineNumber}, Sample{sample.opcode, sample.location, 0, 0});
+        line->second.count += sample.count;
+        line->second.ticks += sample.ticks;
+    }
+    const std::uint64_t total = weight(profile, totalCount, totalTicks);
+    const auto hotter = [&](const Sample& a, const Sample& b) {
+        return weight(profile, a.count, a.ticks) > weight(profile, b.count, b.ticks);
+    };
+
+    output << "Executed " << totalCount << " instructions";
+    if (profile.measureTicks) {
+        output << " in " << totalTicks << " " << TICK_UNIT;
+    }
+    output << "\n\nHot lines:\n";
+    writeHeader(output, profile);
+    std::vector<Sample> sortedLines;
+    for (const auto& [key, line] : lines) {
+        sortedLines.push_back(line);
+    }
+    std::stable_sort(sortedLines.begin(), sortedLines.end(), hotter);
+    for (const Sample& line : sortedLines) {
+        const SourceLocation location = sourceMap().resolve(line.location);
+        writeRow(output, profile, line.count, line.ticks, total);
+        output << location.filePath << ":" << location.lineNumber << "  " << sourceLine(location) << "\n";
+    }
+
+    output << "\nHot instructions:\n";
+    writeHeader(output, profile);
+    std::stable_sort(samples.begin(), samples.end(), hotter);
+    for (const Sample& sample : samples) {
+        writeRow(output, profile, sample.count, sample.ticks, total);
+        output << sourceMap().resolve(sample.location) << "  " << opcodeName(sample.opcode) << "\n";
+    }
+}
+
+void porth::writeCollapsedStacks(
+    std::ostream& output, const Profile& profile, const Bytecode& bytecode, const std::vector<Op>& program) {
+    // The innermost while or if around each op, and for the blocks themselves the one around them.
+    std::vector<std::optional<std::size_t>> enclosing(program.size());
+    std::unordered_map<LocationId, std::size_t> opAt;
+    std::vector<std::size_t> open;
+    for (std::size_t ip = 0; ip < program.size(); ++ip) {
+        opAt.try_emplace(program[ip].location, ip);
+        if (!open.empty()) {
+            enclosing[ip] = open.back();
+        }
+        if (program[ip].id == OpIds::While || program[ip].id == OpIds::If) {
+            open.push_back(ip);
+        } else if (program[ip].id == OpIds::End && !open.empty()) {
+            open.pop_back();
+        }
+    }
+
+    std::map<std::string, std::uint64_t> stacks;
+    for (const Sample& sample : collectSamples(profile, bytecode)) {
+        const SourceLocation location = sourceMap().resolve(sample.location);
+        std::string stack = "line " + std::to_string(location.lineNumber);
+        if (const auto op = opAt.find(sample.location); op != opAt.end()) {
+            for (std::optional<std::size_t> block = enclosing[op->second]; block; block = enclosing[*block]) {
+                const char* const kind = program[*block].id == OpIds::While ? "while:" : "if:";
+                stack.insert(0, kind + std::to_string(sourceMap().resolve(program[*block].location).lineNumber) + ";");
+            }
+        }
+        stack.insert(0, std::string{location.filePath} + ";");
+        stacks[stack] += weight(profile, sample.count, sample.ticks);
+    }
+    for (const auto& [stack, value] : stacks) {
+        output << stack << " " << value << "\n";
+    }
+}
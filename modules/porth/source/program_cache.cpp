@@ -0,0 +1,213 @@
+#include "porth/program_cache.hpp"
+
+#include "porth/hash.hpp"
+#include "porth/parser.hpp"
+#include "porth/source_file.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+constexpr std::array<char, 8> CACHE_MAGIC = {'P', 'O', 'R', 'T', 'H', 'C', '\r', '\n'};
+// Bump whenever the layout below or the meaning of an op changes.
+constexpr std::uint32_t CACHE_VERSION = 1;
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct CacheHeader {
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint32_t opIdCount;
+    std::uint32_t fileCount;
+    std::uint64_t sourceHash;
+    std::uint64_t opCount;
+    // Size of the whole cache file and hash of everything after the header, to reject truncated or torn writes.
+    std::uint64_t totalSize;
+    std::uint64_t payloadHash;
+};
+
+// The header is followed by fileCount length-prefixed file names, each padded to 8 bytes, then opCount CachedOps and
+// then opCount CachedLocations.
+struct CachedOp {
+    std::uint32_t id;
+    std::uint32_t reserved;
+    std::int64_t operand;
+};
+
+struct CachedLocation {
+    std::uint32_t file;
+    std::uint32_t lineNumber;
+    std::uint32_t columnNumber;
+};
+
+template <typename T> void append(std::string& buffer, const T& value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof value);
+}
+
+template <typename T> bool read(std::string_view& bytes, T& value) {
+    if (bytes.size() < sizeof value) {
+        return false;
+    }
+    std::memcpy(&value, bytes.data(), sizeof value);
+    bytes.remove_prefix(sizeof value);
+    return true;
+}
+
+std::size_t padding(const std::size_t length) {
+    return (8 - length % 8) % 8;
+}
+
+std::string porth::programCachePath(const std::string& sourcePath, const std::string& cacheDir) {
+    std::filesystem::path path{sourcePath};
+    if (cacheDir.empty()) {
+        return path.replace_extension(".porthc").string();
+    }
+    // Different sources with the same name must not share an entry, so the name carries a hash of the full path.
+    std::ostringstream name;
+    name << path.stem().string() << "-" << std::hex << std::setw(16) << std::setfill('0')
+         << hashBytes(std::filesystem::absolute(path).string()) << ".porthc";
+    return (std::filesystem::path{cacheDir} / name.str()).string();
+}
+
+std::optional<std::vector<porth::Op>> porth::readProgramCache(
+    const std::string& cachePath,
+    const std::uint64_t sourceHash) {
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(cachePath, error)) {
+        return std::nullopt;
+    }
+    std::optional<MappedFile> file;
+    try {
+        file.emplace(cachePath);
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+    std::string_view bytes = file->contents();
+    CacheHeader header{};
+    if (!read(bytes, header) || header.magic != CACHE_MAGIC || header.version != CACHE_VERSION ||
+        header.byteOrder != BYTE_ORDER_MARK || header.opIdCount != OpIds::Count.discriminant ||
+        header.sourceHash != sourceHash || header.totalSize != file->contents().size() ||
+        header.payloadHash != hashBytes(bytes)) {
+        return std::nullopt;
+    }
+
+    std::vector<SourceMap::FileId> fileIds;
+    for (std::uint32_t i = 0; i < header.fileCount; ++i) {
+        std::uint32_t length = 0;
+        if (!read(bytes, length) || bytes.size() < length + padding(sizeof length + length)) {
+            return std::nullopt;
+        }
+        fileIds.push_back(sourceMap().internFile(bytes.substr(0, length)));
+        bytes.remove_prefix(length + padding(sizeof length + length));
+    }
+
+    if (bytes.size() != header.opCount * (sizeof(CachedOp) + sizeof(CachedLocation))) {
+        return std::nullopt;
+    }
+    std::string_view locations = bytes.substr(header.opCount * sizeof(CachedOp));
+    std::vector<Op> program;
+    program.reserve(header.opCount);
+    for (std::uint64_t i = 0; i < header.opCount; ++i) {
+        CachedOp op{};
+        CachedLocation location{};
+        read(bytes, op);
+        read(locations, location);
+        if (op.id >= OpIds::Count.discriminant || location.file >= fileIds.size()) {
+            return std::nullopt;
+        }
+        const SourceMap::FileId file = fileIds[location.file];
+        const LocationId locationId = sourceMap().add(file, location.lineNumber, location.columnNumber);
+        program.emplace_back(OpId{op.id}, locationId, op.operand);
+    }
+    return program;
+}
+
+bool porth::writeProgramCache(
+    const std::string& cachePath,
+    const std::uint64_t sourceHash,
+    const std::vector<Op>& program) {
+    std::vector<std::string_view> files;
+    std::string payload;
+    std::string opBytes;
+    std::string locationBytes;
+    for (const Op& op : program) {
+        const SourceLocation location = sourceMap().resolve(op.location);
+        auto file = std::find(files.begin(), files.end(), location.filePath);
+        if (file == files.end()) {
+            files.push_back(location.filePath);
+            file = files.end() - 1;
+            append(payload, static_cast<std::uint32_t>(location.filePath.size()));
+            payload.append(location.filePath);
+            payload.append(padding(sizeof(std::uint32_t) + location.filePath.size()), '\0');
+        }
+        append(opBytes, CachedOp{op.id.discriminant, 0, op.operand});
+        append(
+            locationBytes,
+            CachedLocation{
+                static_cast<std::uint32_t>(file - files.begin()),
+                static_cast<std::uint32_t>(location.lineNumber),
+                static_cast<std::uint32_t>(location.columnNumber),
+            });
+    }
+    payload += opBytes;
+    payload += locationBytes;
+
+    const CacheHeader header{
+        CACHE_MAGIC,
+        CACHE_VERSION,
+        BYTE_ORDER_MARK,
+        OpIds::Count.discriminant,
+        static_cast<std::uint32_t>(files.size()),
+        sourceHash,
+        program.size(),
+        sizeof(CacheHeader) + payload.size(),
+        hashBytes(payload),
+    };
+    std::string contents;
+    append(contents, header);
+    contents += payload;
+
+    std::error_code error;
+    if (const std::filesystem::path directory = std::filesystem::path{cachePath}.parent_path(); !directory.empty()) {
+        std::filesystem::create_directories(directory, error);
+    }
+    std::ostringstream tempPath;
+    tempPath << cachePath << ".tmp" << std::hex << std::random_device{}();
+    {
+        std::ofstream output{tempPath.str(), std::ios::binary};
+        if (!output || !output.write(contents.data(), static_cast<std::streamsize>(contents.size())) ||
+            !output.flush()) {
+            output.close();
+            std::filesystem::remove(tempPath.str(), error);
+            return false;
+        }
+    }
+    std::filesystem::rename(tempPath.str(), cachePath, error);
+    if (error) {
+        std::filesystem::remove(tempPath.str(), error);
+        return false;
+    }
+    return true;
+}
+
+std::vector<porth::Op> porth::loadProgramCached(
+    const std::string& sourcePath,
+    const std::string& cachePath,
+    const std::size_t lexThreads) {
+    // the cached locations name the file by the path it was loaded from, so a copy elsewhere needs its own cache
+    const std::uint64_t sourceHash = hashBytes(mapSourceFile(sourcePath), hashBytes(sourcePath));
+    if (std::optional<std::vector<Op>> program = readProgramCache(cachePath, sourceHash)) {
+        return std::move(*program);
+    }
+    std::vector<Op> program = loadProgramFromFile(sourcePath, lexThreads);
+    if (!writeProgramCache(cachePath, sourceHash, program)) {
+        std::cerr << "[WARN] failed to write program cache " << cachePath << "\n";
+    }
+    return program;
+}
@@ -0,0 +1,477 @@
+#include "porth/range_analysis.hpp"
+
+#include "porth/stack_analysis.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <utility>
+
+namespace OpIds = porth::OpIds;
+
+constexpr std::int64_t MIN = std::numeric_limits<std::int64_t>::min();
+constexpr std::int64_t MAX = std::numeric_limits<std::int64_t>::max();
+
+// A loop head's ranges only grow this many times before their growing bounds jump to the limits, so that the
+// analysis ends.
+constexpr std::size_t WIDENING_DELAY = 3;
+// Rounds run after the ranges stop growing, to win back bounds that widening threw away.
+constexpr std::size_t NARROWING_ROUNDS = 2;
+
+// The values a slot can hold, lo and hi included. Empty when lo > hi.
+struct Range {
+    std::int64_t lo = MIN;
+    std::int64_t hi = MAX;
+
+    bool operator==(const Range& other) const = default;
+};
+
+// Names a value rather than a slot, so that what a comparison learns about a value applies to every copy of it.
+using ValueId = std::uint64_t;
+
+// The 0 or 1 that comparing two values left, with the ranges they had at the time.
+struct Comparison {
+    porth::OpId op;
+    ValueId left;
+    Range leftRange;
+    ValueId right;
+    Range rightRange;
+
+    bool operator==(const Comparison& other) const = default;
+};
+
+struct Value {
+    Range range;
+    ValueId id = 0;
+    std::optional<Comparison> comparison;
+};
+
+// What is known about the stack on entry to an op, from the bottom up.
+using State = std::vector<Value>;
+
+std::optional<std::int64_t> checkedAdd(const std::int64_t a, const std::int64_t b) {
+    if ((b > 0 && a > MAX - b) || (b < 0 && a < MIN - b)) {
+        return std::nullopt;
+    }
+    return a + b;
+}
+
+std::optional<std::int64_t> checkedSub(const std::int64_t a, const std::int64_t b) {
+    if ((b < 0 && a > MAX + b) || (b > 0 && a < MIN + b)) {
+        return std::nullopt;
+    }
+    return a - b;
+}
+
+Range hull(const Range a, const Range b) {
+    return {std::min(a.lo, b.lo), std::max(a.hi, b.hi)};
+}
+
+// Arithmetic that can wrap around could produce any value.
+Range plus(const Range a, const Range b) {
+    const std::optional<std::int64_t> lo = checkedAdd(a.lo, b.lo);
+    const std::optional<std::int64_t> hi = checkedAdd(a.hi, b.hi);
+    return lo && hi ? Range{*lo, *hi} : Range{};
+}
+
+Range minus(const Range a, const Range b) {
+    const std::optional<std::int64_t> lo = checkedSub(a.lo, b.hi);
+    const std::optional<std::int64_t> hi = checkedSub(a.hi, b.lo);
+    return lo && hi ? Range{*lo, *hi} : Range{};
+}
+
+Range bitAnd(const Range a, const Range b) {
+    if (a.lo >= 0 && b.lo >= 0) {
+        return {0, std::min(a.hi, b.hi)};
+    }
+    if (a.lo >= 0) {
+        return {0, a.hi};
+    }
+    if (b.lo >= 0) {
+        return {0, b.hi};
+    }
+    return {};
+}
+
+Range bitOr(const Range a, const Range b) {
+    if (a.lo < 0 || b.lo < 0) {
+        return {};
+    }
+    // no bit above the highest of either can be set
+    std::int64_t ones = 0;
+    while (ones < std::max(a.hi, b.hi)) {
+        ones = ones << 1 | 1;
+    }
+    return {std::max(a.lo, b.lo), ones};
+}
+
+// Shifts by less than 0 or more than 63 have no meaning in C++, and x86-64 takes the count modulo 64.
+bool validShift(const Range count) {
+    return count.lo >= 0 && count.hi <= 63;
+}
+
+Range shiftRight(const Range a, const Range count) {
+    if (!validShift(count)) {
+        return {};
+    }
+    // arithmetic: shifting further moves negative values up and positive ones down
+    return {std::min(a.lo >> count.lo, a.lo >> count.hi), std::max(a.hi >> count.lo, a.hi >> count.hi)};
+}
+
+Range shiftLeft(const Range a, const Range count) {
+    if (!validShift(count) || a.lo < 0 || a.hi > MAX >> count.hi) {
+        return {};
+    }
+    return {a.lo << count.lo, a.hi << count.hi};
+}
+
+Range modulo(const Range a, const Range b) {
+    if (b.lo <= 0) {
+        return {};
+    }
+    // the remainder takes the sign of a and is smaller than b
+    const std::int64_t bound = b.hi - 1;
+    if (a.lo >= 0) {
+        return {0, std::min(a.hi, bound)};
+    }
+    if (a.hi <= 0) {
+        return {std::max(a.lo, -bound), 0};
+    }
+    return {-bound, bound};
+}
+
+// Narrows every copy of the value to the range. Fails when a copy is left with no possible value.
+bool narrow(State& state, const ValueId id, const Range range) {
+    for (Value& value : state) {
+        if (value.id == id) {
+            value.range.lo = std::max(value.range.lo, range.lo);
+            value.range.hi = std::min(value.range.hi, range.hi);
+            if (value.range.lo > value.range.hi) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Narrows the state to what holds once a branch has seen the comparison hold, or fail. Fails when that cannot happen.
+bool assume(State& state, const Comparison& comparison, const bool holds) {
+    enum struct Relation {
+        Less,
+        LessEqual,
+        Equal,
+        NotEqual,
+    };
+    // a relation between a and b, with > and >= turned around
+    Relation relation = Relation::Equal;
+    ValueId a = comparison.left;
+    Range aRange = comparison.leftRange;
+    ValueId b = comparison.right;
+    Range bRange = comparison.rightRange;
+    const auto turnAround = [&] {
+        std::swap(a, b);
+        std::swap(aRange, bRange);
+    };
+    if (comparison.op == OpIds::Lt || comparison.op == OpIds::Gt) {
+        relation = Relation::Less;
+    } else if (comparison.op == OpIds::Le || comparison.op == OpIds::Ge) {
+        relation = Relation::LessEqual;
+    } else if (comparison.op == OpIds::Ne) {
+        relation = Relation::NotEqual;
+    }
+    if (comparison.op == OpIds::Gt || comparison.op == OpIds::Ge) {
+        turnAround();
+    }
+    if (!holds) {
+        // not a < b is b <= a, and not a <= b is b < a
+        if (relation == Relation::Less || relation == Relation::LessEqual) {
+            relation = relation == Relation::Less ? Relation::LessEqual : Relation::Less;
+            turnAround();
+        } else {
+            relation = relation == Relation::Equal ? Relation::NotEqual : Relation::Equal;
+        }
+    }
+
+    switch (relation) {
+    case Relation::Less:
+        if (bRange.hi == MIN || aRange.lo == MAX) {
+            return false;
+        }
+        return narrow(state, a, {MIN, bRange.hi - 1}) && narrow(state, b, {aRange.lo + 1, MAX});
+    case Relation::LessEqual:
+        return narrow(state, a, {MIN, bRange.hi}) && narrow(state, b, {aRange.lo, MAX});
+    case Relation::Equal:
+        return narrow(state, a, bRange) && narrow(state, b, aRange);
+    case Relation::NotEqual:
+        break;
+    }
+    return true;
+}
+
+struct Analysis {
+    const std::vector<porth::Op>& program;
+    // targets of jumps back to them, which every cycle of the program passes through
+    std::vector<bool> loopHeads;
+    std::size_t maxDepth;
+    std::vector<std::optional<State>> states;
+    std::vector<std::size_t> updates;
+
+    Analysis(const std::vector<porth::Op>& program, const std::size_t maxDepth)
+        : program(program),
+          loopHeads(program.size()),
+          maxDepth(maxDepth),
+          states(program.size()),
+          updates(program.size()) {
+        for (std::size_t ip = 0; ip < program.size(); ++ip) {
+            const porth::Op& op = program[ip];
+            if ((op.id == OpIds::If || op.id == OpIds::Do || op.id == OpIds::Else || op.id == OpIds::End) &&
+                static_cast<std::size_t>(op.operand) <= ip) {
+                loopHeads[static_cast<std::size_t>(op.operand)] = true;
+            }
+        }
+    }
+
+    // The value an op computes. No op computes more than one: the rest of its outputs are copies.
+    [[nodiscard]] ValueId computed(const std::size_t ip) const {
+        return ip + 1;
+    }
+
+    // Whatever a slot holds on entry to a loop head. Within one trip around the loop, each op's value is then a
+    // single value, and a comparison from an earlier trip is never taken for one about the current trip.
+    [[nodiscard]] ValueId merged(const std::size_t ip, const std::size_t slot) const {
+        return program.size() + 1 + ip * (maxDepth + 1) + slot;
+    }
+
+    // Runs the op on the state, leaving the state after it. Branches pop their condition in step.
+    void execute(const std::size_t ip, State& state) const {
+        static_assert(OpIds::Count.discriminant == 34, "Exhaustive handling of OpIds in Analysis::execute");
+        const porth::Op& op = program[ip];
+        const auto pop = [&] {
+            Value value = state.back();
+            state.pop_back();
+            return value;
+        };
+        const auto push = [&](const Range range) { state.push_back({range, computed(ip), std::nullopt}); };
+
+        if (op.id == OpIds::Push) {
+            push({op.operand, op.operand});
+        } else if (op.id == OpIds::Mem) {
+            push({0, 0});
+        } else if (
+            op.id == OpIds::Plus || op.id == OpIds::Minus || op.id == OpIds::Band || op.id == OpIds::Bor ||
+            op.id == OpIds::Shr || op.id == OpIds::Shl || op.id == OpIds::Mod) {
+            const Range b = pop().range;
+            const Range a = pop().range;
+            if (op.id == OpIds::Plus) {
+                push(plus(a, b));
+            } else if (op.id == OpIds::Minus) {
+                push(minus(a, b));
+            } else if (op.id == OpIds::Band) {
+                push(bitAnd(a, b));
+            } else if (op.id == OpIds::Bor) {
+                push(bitOr(a, b));
+            } else if (op.id == OpIds::Shr) {
+                push(shiftRight(a, b));
+            } else if (op.id == OpIds::Shl) {
+                push(shiftLeft(a, b));
+            } else {
+                push(modulo(a, b));
+            }
+        } else if (
+            op.id == OpIds::Eq || op.id == OpIds::Ne || op.id == OpIds::Gt || op.id == OpIds::Lt ||
+            op.id == OpIds::Ge || op.id == OpIds::Le) {
+            const Value b = pop();
+            const Value a = pop();
+            push({0, 1});
+            state.back().comparison = Comparison{op.id, a.id, a.range, b.id, b.range};
+        } else if (op.id == OpIds::Dup) {
+            state.push_back(state.back());
+        } else if (op.id == OpIds::Dup2) {
+            state.push_back(state[state.size() - 2]);
+            state.push_back(state[state.size() - 2]);
+        } else if (op.id == OpIds::Over) {
+            state.push_back(state[state.size() - 2]);
+        } else if (op.id == OpIds::Swap) {
+            std::swap(state[state.size() - 1], state[state.size() - 2]);
+        } else if (op.id == OpIds::Drop) {
+            pop();
+        } else if (op.id == OpIds::Load) {
+            pop();
+            push({0, 255});
+        } else if (op.id == OpIds::Store) {
+            pop();
+            pop();
+        } else if (
+            op.id == OpIds::Syscall1 || op.id == OpIds::Syscall2 || op.id == OpIds::Syscall3 ||
+            op.id == OpIds::Syscall4 || op.id == OpIds::Syscall5 || op.id == OpIds::Syscall6) {
+            for (std::size_t i = 0; i < porth::stackEffect(op.id).inputs; ++i) {
+                pop();
+            }
+            push({});
+        }
+        // print only peeks, and the rest only jump
+    }
+
+    // The states that op ip passes on, along with where they go. Branches that cannot be taken pass on nothing.
+    [[nodiscard]] std::vector<std::pair<std::size_t, State>> step(const std::size_t ip, State state) const {
+        const porth::Op& op = program[ip];
+        const auto target = static_cast<std::size_t>(op.operand);
+        std::vector<std::pair<std::size_t, State>> successors;
+        if (op.id == OpIds::If || op.id == OpIds::Do) {
+            const Value condition = state.back();
+            state.pop_back();
+            State taken = state;
+            if (condition.range != Range{0, 0} &&
+                (!condition.comparison || assume(taken, *condition.comparison, true))) {
+                successors.emplace_back(ip + 1, std::move(taken));
+            }
+            if (condition.range.lo <= 0 && condition.range.hi >= 0 &&
+                (!condition.comparison || assume(state, *condition.comparison, false))) {
+                successors.emplace_back(target, std::move(state));
+            }
+        } else if (op.id == OpIds::Else || op.id == OpIds::End) {
+            successors.emplace_back(target, std::move(state));
+        } else {
+            execute(ip, state);
+            successors.emplace_back(ip + 1, std::move(state));
+        }
+        return successors;
+    }
+
+    // Joins a state reaching ip into what is known on entry to it. Returns whether that changed.
+    bool join(std::optional<State>& known, const std::size_t ip, State incoming, const bool widen) const {
+        if (loopHeads[ip]) {
+            for (std::size_t slot = 0; slot < incoming.size(); ++slot) {
+                incoming[slot].id = merged(ip, slot);
+                incoming[slot].comparison.reset();
+            }
+        }
+        if (!known) {
+            known = std::move(incoming);
+            return true;
+        }
+        bool changed = false;
+        for (std::size_t slot = 0; slot < known->size(); ++slot) {
+            Value& value = (*known)[slot];
+            const Value& other = incoming[slot];
+            Range range = hull(value.range, other.range);
+            if (widen) {
+                range.lo = range.lo < value.range.lo ? MIN : range.lo;
+                range.hi = range.hi > value.range.hi ? MAX : range.hi;
+            }
+            if (range != value.range) {
+                value.range = range;
+                changed = true;
+            }
+            if (value.id != other.id && value.id != merged(ip, slot)) {
+                value.id = merged(ip, slot);
+                changed = true;
+            }
+            if (value.comparison && value.comparison != other.comparison) {
+                Comparison& comparison = *value.comparison;
+                if (other.comparison && comparison.op == other.comparison->op &&
+                    comparison.left == other.comparison->left && comparison.right == other.comparison->right) {
+                    // the same comparison of the same values, which may have had other ranges on the way here
+                    const Range leftRange = hull(comparison.leftRange, other.comparison->leftRange);
+                    const Range rightRange = hull(comparison.rightRange, other.comparison->rightRange);
+                    if (leftRange != comparison.leftRange || rightRange != comparison.rightRange) {
+                        comparison.leftRange = leftRange;
+                        comparison.rightRange = rightRange;
+                        changed = true;
+                    }
+                } else {
+                    value.comparison.reset();
+                    changed = true;
+                }
+            }
+        }
+        return changed;
+    }
+
+    void run() {
+        // grow the ranges until they hold every value the program can compute, stepping only the ops whose state
+        // changed, earliest first
+        join(states[0], 0, State{}, false);
+        std::priority_queue<std::size_t, std::vector<std::size_t>, std::greater<>> worklist;
+        std::vector<bool> queued(program.size());
+        worklist.push(0);
+        queued[0] = true;
+        while (!worklist.empty()) {
+            const std::size_t ip = worklist.top();
+            worklist.pop();
+            queued[ip] = false;
+            for (auto& [target, state] : step(ip, *states[ip])) {
+                if (target < program.size() &&
+                    join(states[target], target, std::move(state), updates[target] >= WIDENING_DELAY)) {
+                    if (loopHeads[target]) {
+                        ++updates[target];
+                    }
+                    if (!queued[target]) {
+                        worklist.push(target);
+                        queued[target] = true;
+                    }
+                }
+            }
+        }
+
+        // then take them in again, running through the program in order with what comes back around each loop taken
+        // from the round before
+        for (std::size_t round = 0; round < NARROWING_ROUNDS; ++round) {
+            std::vector<std::optional<State>> next(program.size());
+            join(next[0], 0, State{}, false);
+            for (std::size_t ip = 0; ip < program.size(); ++ip) {
+                if (!states[ip]) {
+                    continue;
+                }
+                for (auto& [target, state] : step(ip, *states[ip])) {
+                    if (target <= ip) {
+                        join(next[target], target, std::move(state), false);
+                    }
+                }
+            }
+            for (std::size_t ip = 0; ip < program.size(); ++ip) {
+                if (!next[ip]) {
+                    continue;
+                }
+                if (loopHeads[ip]) {
+                    // only a bound that widening threw away comes back, so the ranges cannot grow again
+                    for (std::size_t slot = 0; slot < next[ip]->size(); ++slot) {
+                        Range& range = (*next[ip])[slot].range;
+                        const Range widened = (*states[ip])[slot].range;
+                        range.lo = widened.lo == MIN ? range.lo : widened.lo;
+                        range.hi = widened.hi == MAX ? range.hi : widened.hi;
+                    }
+                }
+                for (auto& [target, state] : step(ip, *next[ip])) {
+                    if (target > ip && target < program.size()) {
+                        join(next[target], target, std::move(state), false);
+                    }
+                }
+            }
+            states = std::move(next);
+        }
+    }
+};
+
+std::vector<bool> porth::provenAccesses(const std::vector<Op>& program, const std::size_t memoryCapacity) {
+    std::vector<bool> proven(program.size());
+    const std::optional<std::size_t> maxDepth = maxStackDepth(program);
+    if (!maxDepth || program.empty() || memoryCapacity == 0) {
+        return proven;
+    }
+    Analysis analysis{program, *maxDepth};
+    analysis.run();
+    for (std::size_t ip = 0; ip < program.size(); ++ip) {
+        const std::optional<State>& state = analysis.states[ip];
+        if (!state || (program[ip].id != OpIds::Load && program[ip].id != OpIds::Store)) {
+            continue;
+        }
+        // a store's address is below the value it stores
+        const Range address = (*state)[state->size() - (program[ip].id == OpIds::Load ? 1 : 2)].range;
+        proven[ip] = address.lo >= 0 && static_cast<std::uint64_t>(address.hi) < memoryCapacity;
+    }
+    return proven;
+}
@@ -0,0 +1,130 @@
+#include "porth/scanner.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PORTH_SCAN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PORTH_SCAN_SSE2
+#endif
+
+constexpr std::uint64_t ALL_WHITESPACE = ~std::uint64_t{0};
+
+porth::ByteClasses porth::classifyBytesScalar(const char* bytes, const std::size_t length) {
+    ByteClasses classes{ALL_WHITESPACE, 0, 0};
+    for (std::size_t i = 0; i < std::min(length, SCAN_BLOCK_SIZE); ++i) {
+        const std::uint64_t bit = std::uint64_t{1} << i;
+        if (!isWhitespace(bytes[i])) {
+            classes.whitespace &= ~bit;
+        }
+        if (bytes[i] == '\n') {
+            classes.newlines |= bit;
+        }
+        if (bytes[i] == '/') {
+            classes.slashes |= bit;
+        }
+    }
+    return classes;
+}
+
+#if defined(PORTH_SCAN_AVX2)
+std::uint64_t bitmask(const __m256i bytes) {
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(bytes));
+}
+
+porth::ByteClasses classifyFullBlock(const char* bytes) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i controlRange = _mm256_set1_epi8('\r' - '\t');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i slash = _mm256_set1_epi8('/');
+    porth::ByteClasses classes{0, 0, 0};
+    for (unsigned half = 0; half < 2; ++half) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + half * 32));
+        const __m256i fromTab = _mm256_sub_epi8(chunk, tab);
+        const __m256i isControl = _mm256_cmpeq_epi8(_mm256_min_epu8(fromTab, controlRange), fromTab);
+        const __m256i isWhitespace = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), isControl);
+        const unsigned shift = half * 32;
+        classes.whitespace |= bitmask(isWhitespace) << shift;
+        classes.newlines |= bitmask(_mm256_cmpeq_epi8(chunk, newline)) << shift;
+        classes.slashes |= bitmask(_mm256_cmpeq_epi8(chunk, slash)) << shift;
+    }
+    return classes;
+}
+#elif defined(PORTH_SCAN_SSE2)
+std::uint64_t bitmask(const __m128i bytes) {
+    return static_cast<std::uint16_t>(_mm_movemask_epi8(bytes));
+}
+
+porth::ByteClasses classifyFullBlock(const char* bytes) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i controlRange = _mm_set1_epi8('\r' - '\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i slash = _mm_set1_epi8('/');
+    porth::ByteClasses classes{0, 0, 0};
+    for (unsigned quarter = 0; quarter < 4; ++quarter) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + quarter * 16));
+        // '\t'..'\r' are whitespace; subtracting '\t' turns that into an unsigned range check.
+        const __m128i fromTab = _mm_sub_epi8(chunk, tab);
+        const __m128i isControl = _mm_cmpeq_epi8(_mm_min_epu8(fromTab, controlRange), fromTab);
+        const __m128i isWhitespace = _mm_or_si128(_mm_cmpeq_epi8(chunk, space), isControl);
+        const unsigned shift = quarter * 16;
+        classes.whitespace |= bitmask(isWhitespace) << shift;
+        classes.newlines |= bitmask(_mm_cmpeq_epi8(chunk, newline)) << shift;
+        classes.slashes |= bitmask(_mm_cmpeq_epi8(chunk, slash)) << shift;
+    }
+    return classes;
+}
+#endif
+
+porth::ByteClasses porth::classifyBytesVector(const char* bytes, const std::size_t length) {
+#if defined(PORTH_SCAN_AVX2) || defined(PORTH_SCAN_SSE2)
+    if (length >= SCAN_BLOCK_SIZE) {
+        return classifyFullBlock(bytes);
+    }
+    // The tail of the source is padded with whitespace so the vector loads stay inside the buffer.
+    std::array<char, SCAN_BLOCK_SIZE> padded;
+    padded.fill(' ');
+    std::memcpy(padded.data(), bytes, length);
+    return classifyFullBlock(padded.data());
+#else
+    return classifyBytesScalar(bytes, length);
+#endif
+}
+
+porth::Scanner::Scanner(const std::string_view source) : source(source), current(classify(0)) {
+}
+
+porth::ByteClasses porth::Scanner::classify(const std::size_t blockOffset) const {
+    if (blockOffset >= source.size()) {
+        return {ALL_WHITESPACE, 0, 0};
+    }
+    return classifyBytesVector(source.data() + blockOffset, source.size() - blockOffset);
+}
+
+bool porth::Scanner::next(ScanBlock& block) {
+    if (offset >= source.size()) {
+        return false;
+    }
+    const ByteClasses following = classify(offset + SCAN_BLOCK_SIZE);
+    // bit i of these describes byte i - 1, i + 1 and i + 2 respectively
+    const std::uint64_t whitespaceBefore = current.whitespace << 1 | previousWhitespace;
+    const std::uint64_t slashAfter = current.slashes >> 1 | following.slashes << 63;
+    const std::uint64_t whitespaceTwoAfter = current.whitespace >> 2 | following.whitespace << 62;
+
+    block.offset = offset;
+    block.tokenStarts = ~current.whitespace & whitespaceBefore;
+    block.tokenEnds = current.whitespace & ~whitespaceBefore;
+    block.newlines = current.newlines;
+    block.commentStarts = block.tokenStarts & current.slashes & slashAfter & whitespaceTwoAfter;
+
+    previousWhitespace = current.whitespace >> 63;
+    current = following;
+    offset += SCAN_BLOCK_SIZE;
+    return true;
+}
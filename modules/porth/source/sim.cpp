@@ -1,217 +1,620 @@
 #include "porth/sim.hpp"
 
 #include "porth/mem.hpp"
+#include "porth/output.hpp"
+#include "porth/profile.hpp"
 #include "porth/simulation_error.hpp"
+#include "porth/syscall.hpp"
 
-#include <array>
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
+#include <optional>
 #include <sstream>
+#include <string>
+#include <string_view>
 
-template <typename T> T vecPop(std::vector<T>& v) {
-    assert(!v.empty() && "vecPop: empty vector");
-    T result = std::move(v.back());
-    v.pop_back();
-    return result;
+struct StackUnderflow {};
+
+// For programs whose depth maxStackDepth has proven: a preallocated array and a stack pointer that is never checked.
+struct UncheckedStack {
+    explicit UncheckedStack(const std::size_t capacity) : storage(capacity), top(storage.data()) {
+    }
+
+    void push(const std::int64_t value) {
+        *top++ = value;
+    }
+
+    std::int64_t pop() {
+        return *--top;
+    }
+
+    std::int64_t& back() {
+        return top[-1];
+    }
+
+  private:
+    std::vector<std::int64_t> storage;
+    std::int64_t* top;
+};
+
+// Like UncheckedStack, but the top value is held in a local that the compiler can keep in a register, and only the
+// values below it live in the array. Slot 0 of the array takes whatever top held before the first push.
+struct CachedTopStack {
+    explicit CachedTopStack(const std::size_t capacity) : storage(capacity + 1), below(storage.data()) {
+    }
+
+    void push(const std::int64_t value) {
+        *below++ = top;
+        top = value;
+    }
+
+    std::int64_t pop() {
+        const std::int64_t value = top;
+        top = *--below;
+        return value;
+    }
+
+    std::int64_t& back() {
+        return top;
+    }
+
+  private:
+    std::vector<std::int64_t> storage;
+    std::int64_t* below;
+    std::int64_t top = 0;
+};
+
+// For every other program: grows on demand and reports underflow instead of reading past the bottom.
+struct CheckedStack {
+    explicit CheckedStack(const std::size_t capacity) {
+        values.reserve(capacity);
+    }
+
+    void push(const std::int64_t value) {
+        values.push_back(value);
+    }
+
+    std::int64_t pop() {
+        const std::int64_t value = back();
+        values.pop_back();
+        return value;
+    }
+
+    std::int64_t& back() {
+        if (values.empty()) {
+            throw StackUnderflow{};
+        }
+        return values.back();
+    }
+
+  private:
+    std::vector<std::int64_t> values;
+};
+
+// Collects nothing. Its hooks are empty, so the interpreter instantiated with it is the same as without hooks.
+struct NoProfiler {
+    NoProfiler(const porth::SimulationOptions& /*options*/, std::size_t /*codeSize*/) {
+    }
+
+    void enter(std::size_t /*ip*/) {
+    }
+};
+
+// Counts how often the instruction at each offset starts, and if asked, the ticks until the next one starts.
+struct CountingProfiler {
+    CountingProfiler(const porth::SimulationOptions& options, const std::size_t codeSize)
+        : measureTicks(options.profile->measureTicks) {
+        options.profile->counts.assign(codeSize, 0);
+        options.profile->ticks.assign(measureTicks ? codeSize : 0, 0);
+        counts = options.profile->counts.data();
+        ticks = options.profile->ticks.data();
+        started = porth::readTimestamp();
+    }
+
+    // Also runs when an error or exit unwinds the interpreter, so the last instruction gets its ticks too.
+    ~CountingProfiler() {
+        if (measureTicks) {
+            ticks[current] += porth::readTimestamp() - started;
+        }
+    }
+
+    CountingProfiler(const CountingProfiler&) = delete;
+    CountingProfiler(CountingProfiler&&) = delete;
+    CountingProfiler& operator=(const CountingProfiler&) = delete;
+    CountingProfiler& operator=(CountingProfiler&&) = delete;
+
+    void enter(const std::size_t ip) {
+        ++counts[ip];
+        if (measureTicks) {
+            const std::uint64_t now = porth::readTimestamp();
+            ticks[current] += now - started;
+            current = ip;
+            started = now;
+        }
+    }
+
+  private:
+    bool measureTicks;
+    std::uint64_t* counts;
+    std::uint64_t* ticks;
+    std::size_t current = 0;
+    std::uint64_t started;
+};
+
+// Only counts the instructions, in a local that can stay in a register, for -perfstat to divide its counters by.
+struct InstructionCounter {
+    InstructionCounter(const porth::SimulationOptions& options, std::size_t /*codeSize*/)
+        : total(options.executedInstructions) {
+    }
+
+    ~InstructionCounter() {
+        *total = executed;
+    }
+
+    InstructionCounter(const InstructionCounter&) = delete;
+    InstructionCounter(InstructionCounter&&) = delete;
+    InstructionCounter& operator=(const InstructionCounter&) = delete;
+    InstructionCounter& operator=(InstructionCounter&&) = delete;
+
+    void enter(std::size_t /*ip*/) {
+        ++executed;
+    }
+
+  private:
+    std::uint64_t* total;
+    std::uint64_t executed = 0;
+};
+
+// Each handler is written once and expanded either into a case of a switch over the dense opcode, which compilers
+// turn into a jump table, or with PORTH_THREADED_DISPATCH into a label that every handler jumps to through a table of
+// label addresses (GCC/Clang computed goto), which gives each handler its own indirect branch to predict.
+#ifdef PORTH_THREADED_DISPATCH
+#define PORTH_OP(name)                                                                                                 \
+    handle##name:                                                                                                      \
+    profiler.enter(ip);
+#define PORTH_DISPATCH() goto* HANDLERS[code[ip]]
+#else
+#define PORTH_OP(name)                                                                                                 \
+    case static_cast<std::uint8_t>(Opcode::name):                                                                      \
+        profiler.enter(ip);
+#define PORTH_DISPATCH() continue
+#endif
+
+// Pops the syscall number and its arguments, makes the syscall on the host and pushes the result. A macro rather than
+// a function taking the stack, which would have to live in memory for the whole run once its address escapes.
+#define PORTH_SYSCALL(arity)                                                                                           \
+    {                                                                                                                  \
+        const std::int64_t number = stack.pop();                                                                       \
+        porth::SyscallArgs args{};                                                                                     \
+        for (std::size_t i = 0; i < (arity); ++i) {                                                                    \
+            args[i] = stack.pop();                                                                                     \
+        }                                                                                                              \
+        const std::optional<std::int64_t> result = porth::forwardSyscall(host, number, args);                         \
+        if (!result) {                                                                                                 \
+            throwUnsupportedSyscall(bytecode, ip, arity, number);                                                      \
+        }                                                                                                              \
+        stack.push(*result);                                                                                           \
+        ip += 1;                                                                                                       \
+        PORTH_DISPATCH();                                                                                              \
+    }
+
+[[noreturn]] void throwSimulationError(
+    const porth::Bytecode& bytecode, const std::size_t ip, const std::string& message) {
+    std::ostringstream errorMessage;
+    errorMessage << porth::sourceMap().resolve(bytecode.locationAt(ip)) << ": " << message;
+    throw porth::SimulationError{errorMessage.str()};
 }
 
-void porth::simulateProgram(const std::vector<Op>& program, bool debugMode) {
-    static_assert(OpIds::Count.discriminant == 34, "Exhaustive handling of OpIds in simulateProgram");
-    std::vector<std::int64_t> stack;
-    std::array<std::uint8_t, MEM_CAPACITY> mem{};
-    // execution is not linear, so we use a for loop with an index
-    for (size_t ip = 0; ip < program.size();) {
-        if (const Op& op = program[ip]; op.id == OpIds::Push) {
-            stack.push_back(op.operand);
-            ++ip;
-        } else if (op.id == OpIds::Plus) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a + b);
-            ++ip;
-        } else if (op.id == OpIds::Minus) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a - b);
-            ++ip;
-        } else if (op.id == OpIds::Eq) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a == b ? 1 : 0);
-            ++ip;
-        } else if (op.id == OpIds::Ne) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a != b ? 1 : 0);
-            ++ip;
-        } else if (op.id == OpIds::Gt) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a > b ? 1 : 0);
-            ++ip;
-        } else if (op.id == OpIds::Lt) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a < b ? 1 : 0);
-            ++ip;
-        } else if (op.id == OpIds::Ge) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a >= b ? 1 : 0);
-            ++ip;
-        } else if (op.id == OpIds::Le) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a <= b ? 1 : 0);
-            ++ip;
-        } else if (op.id == OpIds::If) {
-            if (const std::int64_t a = vecPop(stack); a == 0) {
+[[noreturn]] void throwUnsupportedSyscall(
+    const porth::Bytecode& bytecode, const std::size_t ip, const int arity, const std::int64_t number) {
+    std::ostringstream errorMessage;
+    errorMessage << "syscall" << arity << ": unsupported syscall " << number;
+    throwSimulationError(bytecode, ip, errorMessage.str());
+}
+
+// The stack and memory are locals rather than parameters, so the stack pointer and the memory base can live in
+// registers instead of being reloaded around every byte stored to mem.
+template <typename Stack, typename Profiler>
+void runBytecode(
+    const porth::Bytecode& bytecode, const std::size_t stackCapacity, const porth::SimulationOptions& options) {
+    using porth::Opcode, porth::OPERAND_SIZE, porth::instructionSize, porth::readOperand;
+    static_assert(static_cast<int>(Opcode::Count) == 47, "Exhaustive handling of Opcodes in runBytecode");
+    const std::uint8_t* const code = bytecode.code.data();
+    // byte offset of the current instruction in code
+    std::size_t ip = 0;
+    Stack stack{stackCapacity};
+    Profiler profiler{options, bytecode.code.size()};
+    const porth::Memory memory{options.memoryCapacity};
+    std::uint8_t* const mem = memory.data();
+    const std::size_t memSize = memory.size();
+    // the program's output goes around std::cout, so whatever is waiting in it has to go first
+    std::cout.flush();
+    porth::OutputChannel output;
+    porth::HostContext host{mem, memSize, output};
+    try {
+#ifdef PORTH_THREADED_DISPATCH
+        // in Opcode order
+        static const void* const HANDLERS[] = {
+            &&handlePush,     &&handlePlus,     &&handleMinus,    &&handleEq,       &&handleNe,   &&handleGt,
+            &&handleLt,       &&handleGe,       &&handleLe,       &&handleIf,       &&handleElse, &&handleEnd,
+            &&handlePrint,    &&handleDup,      &&handleDup2,     &&handleSwap,     &&handleDrop, &&handleWhile,
+            &&handleDo,       &&handleMem,      &&handleLoad,     &&handleStore,    &&handleSyscall1,
+            &&handleSyscall2, &&handleSyscall3, &&handleSyscall4, &&handleSyscall5, &&handleSyscall6,
+            &&handleShr,      &&handleShl,      &&handleBor,      &&handleBand,     &&handleOver, &&handleMod,
+            &&handleAddImm,   &&handleShlImm,   &&handleShrImm,   &&handleBandImm,  &&handleBorImm,
+            &&handleLoadOffset, &&handleStoreImm, &&handleDupLtImmDo, &&handleLoadUnchecked, &&handleStoreUnchecked,
+            &&handleLoadOffsetUnchecked, &&handleStoreImmUnchecked, &&handleHalt,
+        };
+        static_assert(std::size(HANDLERS) == static_cast<std::size_t>(Opcode::Count), "Every Opcode needs a handler");
+        PORTH_DISPATCH();
+#else
+        for (;;) {
+            switch (code[ip]) {
+#endif
+        PORTH_OP(Push) {
+            stack.push(readOperand(code + ip));
+            ip += instructionSize(Opcode::Push);
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Plus) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a + b);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Minus) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a - b);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Eq) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a == b ? 1 : 0);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Ne) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a != b ? 1 : 0);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Gt) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a > b ? 1 : 0);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Lt) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a < b ? 1 : 0);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Ge) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a >= b ? 1 : 0);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Le) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a <= b ? 1 : 0);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(If) {
+            if (const std::int64_t a = stack.pop(); a == 0) {
                 // simulate a goto
-                ip = static_cast<size_t>(op.operand);
+                ip = static_cast<std::size_t>(readOperand(code + ip));
             } else {
-                ++ip;
+                ip += 1 + OPERAND_SIZE;
             }
-        } else if (op.id == OpIds::Else) {
-            ip = static_cast<size_t>(op.operand);
-        } else if (op.id == OpIds::End) {
-            ip = static_cast<size_t>(op.operand);
-        } else if (op.id == OpIds::Print) {
-            std::cout << stack.back() << "\n";
-            ++ip;
-        } else if (op.id == OpIds::Dup) {
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Else) {
+            ip = static_cast<std::size_t>(readOperand(code + ip));
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(End) {
+            ip = static_cast<std::size_t>(readOperand(code + ip));
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Print) {
+            output.writeLine(stack.back());
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Dup) {
             const std::int64_t a = stack.back();
-            stack.push_back(a);
-            ++ip;
-        } else if (op.id == OpIds::Dup2) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a);
-            stack.push_back(b);
-            stack.push_back(a);
-            stack.push_back(b);
-            ++ip;
-        } else if (op.id == OpIds::Swap) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(b);
-            stack.push_back(a);
-            ++ip;
-        } else if (op.id == OpIds::Drop) {
-            stack.pop_back();
-            ++ip;
-        } else if (op.id == OpIds::While) {
-            ++ip;
-        } else if (op.id == OpIds::Do) {
-            const std::int64_t a = vecPop(stack);
-            if (a == 0) {
-                ip = static_cast<size_t>(op.operand);
+            stack.push(a);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Dup2) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a);
+            stack.push(b);
+            stack.push(a);
+            stack.push(b);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Swap) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(b);
+            stack.push(a);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Drop) {
+            stack.pop();
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(While) {
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Do) {
+            if (const std::int64_t a = stack.pop(); a == 0) {
+                ip = static_cast<std::size_t>(readOperand(code + ip));
             } else {
-                ++ip;
+                ip += 1 + OPERAND_SIZE;
             }
-        } else if (op.id == OpIds::Mem) {
-            stack.push_back(0);
-            ++ip;
-        } else if (op.id == OpIds::Load) {
-            const std::int64_t a = vecPop(stack);
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Mem) {
+            stack.push(0);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Load) {
+            const std::int64_t a = stack.pop();
             // Interpret a as a memory address.
             // Here be dragons.
             const auto addr = static_cast<std::size_t>(a);
-            if (addr >= mem.size()) {
+            if (addr >= memSize) {
                 std::ostringstream errorMessage;
                 errorMessage << "load: invalid memory address " << addr;
-                throw SimulationError(errorMessage.str());
+                throwSimulationError(bytecode, ip, errorMessage.str());
             }
             const std::uint8_t b = mem[addr];
-            stack.push_back(static_cast<std::int64_t>(b));
-            ++ip;
-        } else if (op.id == OpIds::Store) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
+            stack.push(static_cast<std::int64_t>(b));
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Store) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
             // Interpret a as a memory address.
             // Here be dragons.
             const auto addr = static_cast<std::size_t>(a);
-            if (addr >= mem.size()) {
+            if (addr >= memSize) {
                 std::ostringstream errorMessage;
                 errorMessage << "store: invalid memory address " << addr;
-                throw SimulationError(errorMessage.str());
+                throwSimulationError(bytecode, ip, errorMessage.str());
             }
             mem[addr] = static_cast<std::uint8_t>(b);
-            ++ip;
-        } else if (op.id == OpIds::Syscall1) {
-            throw SimulationError("syscall1: unimplemented");
-        } else if (op.id == OpIds::Syscall2) {
-            throw SimulationError("syscall2: unimplemented");
-        } else if (op.id == OpIds::Syscall3) {
-            const std::int64_t syscallNumber = vecPop(stack);
-            const std::int64_t arg1 = vecPop(stack);
-            const std::int64_t arg2 = vecPop(stack);
-            const std::int64_t arg3 = vecPop(stack);
-            if (syscallNumber == 1) {
-                const std::int64_t fd = arg1;
-                const std::int64_t buf = arg2;
-                const std::int64_t count = arg3;
-                const std::string_view s = {
-                    reinterpret_cast<const char*>(&mem[buf]),
-                    static_cast<std::size_t>(count),
-                };
-                if (fd == 1) {
-                    std::cout << s;
-                } else if (fd == 2) {
-                    std::cerr << s;
-                } else {
-                    std::ostringstream errorMessage;
-                    errorMessage << "syscall3: unknown file descriptor " << fd;
-                    throw SimulationError(errorMessage.str());
-                }
-            } else {
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Syscall1) {
+            PORTH_SYSCALL(1);
+        }
+        PORTH_OP(Syscall2) {
+            PORTH_SYSCALL(2);
+        }
+        PORTH_OP(Syscall3) {
+            PORTH_SYSCALL(3);
+        }
+        PORTH_OP(Syscall4) {
+            PORTH_SYSCALL(4);
+        }
+        PORTH_OP(Syscall5) {
+            PORTH_SYSCALL(5);
+        }
+        PORTH_OP(Syscall6) {
+            PORTH_SYSCALL(6);
+        }
+        PORTH_OP(Shr) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a >> b);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Shl) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a << b);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Bor) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a | b);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Band) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a & b);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Over) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a);
+            stack.push(b);
+            stack.push(a);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Mod) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            stack.push(a % b);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(AddImm) {
+            stack.back() += readOperand(code + ip);
+            ip += instructionSize(Opcode::AddImm);
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(ShlImm) {
+            stack.back() <<= readOperand(code + ip);
+            ip += instructionSize(Opcode::ShlImm);
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(ShrImm) {
+            stack.back() >>= readOperand(code + ip);
+            ip += instructionSize(Opcode::ShrImm);
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(BandImm) {
+            stack.back() &= readOperand(code + ip);
+            ip += instructionSize(Opcode::BandImm);
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(BorImm) {
+            stack.back() |= readOperand(code + ip);
+            ip += instructionSize(Opcode::BorImm);
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(LoadOffset) {
+            std::int64_t& a = stack.back();
+            const auto addr = static_cast<std::size_t>(a + readOperand(code + ip));
+            if (addr >= memSize) {
+                std::ostringstream errorMessage;
+                errorMessage << "load: invalid memory address " << addr;
+                throwSimulationError(bytecode, ip, errorMessage.str());
+            }
+            a = static_cast<std::int64_t>(mem[addr]);
+            ip += instructionSize(Opcode::LoadOffset);
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(StoreImm) {
+            const std::int64_t a = stack.pop();
+            const auto addr = static_cast<std::size_t>(a);
+            if (addr >= memSize) {
                 std::ostringstream errorMessage;
-                errorMessage << "syscall3: unknown syscall " << syscallNumber;
-                throw SimulationError(errorMessage.str());
+                errorMessage << "store: invalid memory address " << addr;
+                throwSimulationError(bytecode, ip, errorMessage.str());
+            }
+            mem[addr] = static_cast<std::uint8_t>(readOperand(code + ip));
+            ip += instructionSize(Opcode::StoreImm);
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(DupLtImmDo) {
+            if (stack.back() < readOperand(code + ip)) {
+                ip += instructionSize(Opcode::DupLtImmDo);
+            } else {
+                ip = static_cast<std::size_t>(readOperand(code + ip, 1));
             }
-            ++ip;
-        } else if (op.id == OpIds::Syscall4) {
-            throw SimulationError("syscall4: unimplemented");
-        } else if (op.id == OpIds::Syscall5) {
-            throw SimulationError("syscall5: unimplemented");
-        } else if (op.id == OpIds::Syscall6) {
-            throw SimulationError("syscall6: unimplemented");
-        } else if (op.id == OpIds::Shr) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a >> b);
-            ++ip;
-        } else if (op.id == OpIds::Shl) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a << b);
-            ++ip;
-        } else if (op.id == OpIds::Bor) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a | b);
-            ++ip;
-        } else if (op.id == OpIds::Band) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a & b);
-            ++ip;
-        } else if (op.id == OpIds::Over) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a);
-            stack.push_back(b);
-            stack.push_back(a);
-            ++ip;
-        } else if (op.id == OpIds::Mod) {
-            const std::int64_t b = vecPop(stack);
-            const std::int64_t a = vecPop(stack);
-            stack.push_back(a % b);
-            ++ip;
-        }
-    }
-    if (debugMode) {
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(LoadUnchecked) {
+            stack.back() = static_cast<std::int64_t>(mem[static_cast<std::size_t>(stack.back())]);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(StoreUnchecked) {
+            const std::int64_t b = stack.pop();
+            const std::int64_t a = stack.pop();
+            mem[static_cast<std::size_t>(a)] = static_cast<std::uint8_t>(b);
+            ip += 1;
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(LoadOffsetUnchecked) {
+            std::int64_t& a = stack.back();
+            a = static_cast<std::int64_t>(mem[static_cast<std::size_t>(a + readOperand(code + ip))]);
+            ip += instructionSize(Opcode::LoadOffsetUnchecked);
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(StoreImmUnchecked) {
+            const std::int64_t a = stack.pop();
+            mem[static_cast<std::size_t>(a)] = static_cast<std::uint8_t>(readOperand(code + ip));
+            ip += instructionSize(Opcode::StoreImmUnchecked);
+            PORTH_DISPATCH();
+        }
+        PORTH_OP(Halt) {
+            goto halt;
+        }
+#ifndef PORTH_THREADED_DISPATCH
+            default:
+                throwSimulationError(bytecode, ip, "invalid opcode");
+            }
+        }
+#endif
+    } catch (const StackUnderflow&) {
+        throwSimulationError(bytecode, ip, "stack underflow");
+    }
+halt:
+    output.flush();
+    if (options.debugMode) {
         std::cout << "[INFO] Memory dump\n";
-        const std::string_view s{reinterpret_cast<const char*>(mem.data()), 20};
+        const std::string_view s{reinterpret_cast<const char*>(mem), std::min<std::size_t>(memSize, 20)};
         std::cout << s << "\n";
     }
 }
+
+// Profiling is a separate instantiation of the interpreter rather than a check in every handler.
+template <typename Stack>
+void runEngine(
+    const porth::Bytecode& bytecode, const std::size_t stackCapacity, const porth::SimulationOptions& options) {
+    if (options.profile != nullptr) {
+        runBytecode<Stack, CountingProfiler>(bytecode, stackCapacity, options);
+    } else if (options.executedInstructions != nullptr) {
+        runBytecode<Stack, InstructionCounter>(bytecode, stackCapacity, options);
+    } else {
+        runBytecode<Stack, NoProfiler>(bytecode, stackCapacity, options);
+    }
+}
+
+int porth::simulateProgram(const Bytecode& bytecode, const SimulationOptions& options) {
+    const bool debugMode = options.debugMode;
+    assert(
+        options.memoryCapacity >= bytecode.provenMemory &&
+        "simulateProgram: less memory than the unchecked accesses were proven for");
+    try {
+        if (bytecode.maxStackDepth && options.engine == Engine::CachedTop) {
+            if (debugMode) {
+                std::cout << "[INFO] Stack depth is at most " << *bytecode.maxStackDepth
+                          << ", caching the top of the stack\n";
+            }
+            runEngine<CachedTopStack>(bytecode, *bytecode.maxStackDepth, options);
+        } else if (bytecode.maxStackDepth) {
+            if (debugMode) {
+                std::cout << "[INFO] Stack depth is at most " << *bytecode.maxStackDepth
+                          << ", using an unchecked stack\n";
+            }
+            runEngine<UncheckedStack>(bytecode, *bytecode.maxStackDepth, options);
+        } else {
+            if (debugMode) {
+                std::cout << "[INFO] Stack depth could not be proven, using a checked stack\n";
+            }
+            runEngine<CheckedStack>(bytecode, 0, options);
+        }
+    } catch (const ProgramExit& exit) {
+        return exit.status;
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "porth/source_file.hpp"
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+[[noreturn]] void throwOpenFailure(const std::string& filePath) {
+    std::ostringstream errorMessage;
+    errorMessage << "failed to open " << filePath << " for reading";
+    throw std::runtime_error{errorMessage.str()};
+}
+
+#ifdef _WIN32
+porth::MappedFile::MappedFile(const std::string& filePath) {
+    const std::ifstream file{filePath, std::ios::binary};
+    if (!file) {
+        throwOpenFailure(filePath);
+    }
+    std::ostringstream source;
+    source << file.rdbuf();
+    buffer = source.str();
+    data = buffer.data();
+    size = buffer.size();
+}
+
+porth::MappedFile::~MappedFile() = default;
+#else
+porth::MappedFile::MappedFile(const std::string& filePath) {
+    const int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throwOpenFailure(filePath);
+    }
+    struct stat info {};
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throwOpenFailure(filePath);
+    }
+    size = static_cast<std::size_t>(info.st_size);
+    // mmap rejects empty mappings, and an empty file has no bytes to point into anyway.
+    if (size > 0) {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throwOpenFailure(filePath);
+        }
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapping);
+    }
+    close(fd);
+}
+
+porth::MappedFile::~MappedFile() {
+    if (data != nullptr) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
+#endif
+
+std::string_view porth::MappedFile::contents() const {
+    return {data, size};
+}
+
+struct SourceMapping {
+    std::unique_ptr<porth::MappedFile> file;
+    std::uintmax_t size;
+    std::filesystem::file_time_type modified;
+};
+
+std::string_view porth::mapSourceFile(const std::string& filePath) {
+    static std::map<std::string, SourceMapping, std::less<>> mappedFiles;
+    // tokens of programs loaded before a file changed still point into its old mapping
+    static std::vector<std::unique_ptr<MappedFile>> replacedFiles;
+
+    // A file that changed since it was mapped is mapped again, so it is neither read stale nor past its new end.
+    std::error_code error;
+    const std::uintmax_t size = std::filesystem::file_size(filePath, error);
+    const std::filesystem::file_time_type modified = std::filesystem::last_write_time(filePath, error);
+    if (const auto it = mappedFiles.find(filePath);
+        it != mappedFiles.end() && !error && it->second.size == size && it->second.modified == modified) {
+        return it->second.file->contents();
+    }
+    auto file = std::make_unique<MappedFile>(filePath);
+    const std::string_view contents = file->contents();
+    SourceMapping& mapping = mappedFiles[filePath];
+    if (mapping.file != nullptr) {
+        replacedFiles.push_back(std::move(mapping.file));
+    }
+    mapping = {std::move(file), size, modified};
+    return contents;
+}
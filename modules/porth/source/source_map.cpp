@@ -0,0 +1,75 @@
+#include "porth/source_map.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+constexpr unsigned FILE_BITS = 12;
+constexpr unsigned LINE_BITS = 28;
+constexpr unsigned COLUMN_BITS = 24;
+static_assert(FILE_BITS + LINE_BITS + COLUMN_BITS == 64, "SourceMap locations are packed into one 64-bit word");
+
+constexpr std::uint64_t mask(const unsigned bits) {
+    return (std::uint64_t{1} << bits) - 1;
+}
+
+// Every id a LocationId can hold, so that ids never wrap around onto earlier locations.
+constexpr std::uint64_t MAX_LOCATIONS = std::uint64_t{std::numeric_limits<porth::LocationId>::max()} + 1;
+
+porth::SourceMap::FileId porth::SourceMap::internFile(const std::string_view filePath) {
+    if (const auto it = std::find(files.begin(), files.end(), filePath); it != files.end()) {
+        return static_cast<FileId>(it - files.begin());
+    }
+    if (files.size() > mask(FILE_BITS)) {
+        throw std::runtime_error{"too many source files"};
+    }
+    files.emplace_back(filePath);
+    return static_cast<FileId>(files.size() - 1);
+}
+
+porth::LocationId porth::SourceMap::add(
+    const FileId file,
+    const std::size_t lineNumber,
+    const std::size_t columnNumber) {
+    const std::uint64_t line = std::min<std::uint64_t>(lineNumber, mask(LINE_BITS));
+    const std::uint64_t column = std::min<std::uint64_t>(columnNumber, mask(COLUMN_BITS));
+    if (locations.size() >= MAX_LOCATIONS) {
+        throw std::runtime_error{"too many source locations"};
+    }
+    locations.push_back(std::uint64_t{file} << (LINE_BITS + COLUMN_BITS) | line << COLUMN_BITS | column);
+    return static_cast<LocationId>(locations.size() - 1);
+}
+
+porth::SourceLocation porth::SourceMap::resolve(const LocationId location) const {
+    const std::uint64_t packed = locations.at(location);
+    return {
+        files[packed >> (LINE_BITS + COLUMN_BITS)],
+        static_cast<std::size_t>(packed >> COLUMN_BITS & mask(LINE_BITS)),
+        static_cast<std::size_t>(packed & mask(COLUMN_BITS)),
+    };
+}
+
+porth::LocationId porth::SourceMap::append(const SourceMap& other) {
+    if (other.locations.size() > MAX_LOCATIONS - locations.size()) {
+        throw std::runtime_error{"too many source locations"};
+    }
+    std::vector<std::uint64_t> fileIds;
+    for (const std::string& filePath : other.files) {
+        fileIds.push_back(internFile(filePath));
+    }
+    const auto base = static_cast<LocationId>(locations.size());
+    for (const std::uint64_t packed : other.locations) {
+        const std::uint64_t file = fileIds[packed >> (LINE_BITS + COLUMN_BITS)];
+        locations.push_back(file << (LINE_BITS + COLUMN_BITS) | (packed & mask(LINE_BITS + COLUMN_BITS)));
+    }
+    return base;
+}
+
+porth::SourceMap& porth::sourceMap() {
+    static SourceMap map;
+    return map;
+}
+
+std::ostream& operator<<(std::ostream& os, const porth::SourceLocation& location) {
+    return os << location.filePath << ":" << location.lineNumber << ":" << location.columnNumber;
+}
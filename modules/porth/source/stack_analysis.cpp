@@ -0,0 +1,119 @@
+#include "porth/stack_analysis.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+porth::StackEffect porth::stackEffect(const OpId id) {
+    static_assert(OpIds::Count.discriminant == 34, "Exhaustive handling of OpIds in stackEffect");
+    if (id == OpIds::Push || id == OpIds::Mem) {
+        return {0, 1};
+    }
+    if (id == OpIds::Plus || id == OpIds::Minus || id == OpIds::Eq || id == OpIds::Ne || id == OpIds::Gt ||
+        id == OpIds::Lt || id == OpIds::Ge || id == OpIds::Le || id == OpIds::Shr || id == OpIds::Shl ||
+        id == OpIds::Bor || id == OpIds::Band || id == OpIds::Mod) {
+        return {2, 1};
+    }
+    if (id == OpIds::If || id == OpIds::Do || id == OpIds::Drop) {
+        return {1, 0};
+    }
+    if (id == OpIds::Else || id == OpIds::End || id == OpIds::While) {
+        return {0, 0};
+    }
+    // print only peeks at the top of the stack
+    if (id == OpIds::Print || id == OpIds::Load) {
+        return {1, 1};
+    }
+    if (id == OpIds::Dup) {
+        return {1, 2};
+    }
+    if (id == OpIds::Dup2) {
+        return {2, 4};
+    }
+    if (id == OpIds::Swap) {
+        return {2, 2};
+    }
+    if (id == OpIds::Over) {
+        return {2, 3};
+    }
+    if (id == OpIds::Store) {
+        return {2, 0};
+    }
+    // the syscall number and its arguments, replaced by the result
+    if (id == OpIds::Syscall1) {
+        return {2, 1};
+    }
+    if (id == OpIds::Syscall2) {
+        return {3, 1};
+    }
+    if (id == OpIds::Syscall3) {
+        return {4, 1};
+    }
+    if (id == OpIds::Syscall4) {
+        return {5, 1};
+    }
+    if (id == OpIds::Syscall5) {
+        return {6, 1};
+    }
+    if (id == OpIds::Syscall6) {
+        return {7, 1};
+    }
+    throw std::runtime_error{"unreachable"};
+}
+
+std::optional<std::vector<std::optional<std::size_t>>> porth::stackDepths(const std::vector<Op>& program) {
+    std::vector<std::optional<std::size_t>> depths(program.size());
+    std::vector<std::size_t> pending;
+    const auto reach = [&](const std::size_t ip, const std::size_t depth) {
+        if (ip >= program.size()) {
+            return true;
+        }
+        if (depths[ip]) {
+            return *depths[ip] == depth;
+        }
+        depths[ip] = depth;
+        pending.push_back(ip);
+        return true;
+    };
+
+    if (!reach(0, 0)) {
+        return std::nullopt;
+    }
+    while (!pending.empty()) {
+        const std::size_t ip = pending.back();
+        pending.pop_back();
+        const Op& op = program[ip];
+        const auto [inputs, outputs] = stackEffect(op.id);
+        if (*depths[ip] < inputs) {
+            return std::nullopt;
+        }
+        const std::size_t depth = *depths[ip] - inputs + outputs;
+        const auto target = static_cast<std::size_t>(op.operand);
+        bool consistent;
+        if (op.id == OpIds::If || op.id == OpIds::Do) {
+            consistent = reach(ip + 1, depth) && reach(target, depth);
+        } else if (op.id == OpIds::Else || op.id == OpIds::End) {
+            consistent = reach(target, depth);
+        } else {
+            consistent = reach(ip + 1, depth);
+        }
+        if (!consistent) {
+            return std::nullopt;
+        }
+    }
+    return depths;
+}
+
+std::optional<std::size_t> porth::maxStackDepth(const std::vector<Op>& program) {
+    const std::optional<std::vector<std::optional<std::size_t>>> depths = stackDepths(program);
+    if (!depths) {
+        return std::nullopt;
+    }
+    std::size_t maxDepth = 0;
+    for (std::size_t ip = 0; ip < program.size(); ++ip) {
+        if (const std::optional<std::size_t> depth = (*depths)[ip]) {
+            const auto [inputs, outputs] = stackEffect(program[ip].id);
+            maxDepth = std::max(maxDepth, *depth - inputs + outputs);
+        }
+    }
+    return maxDepth;
+}
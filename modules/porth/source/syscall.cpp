@@ -0,0 +1,132 @@
+#include "porth/syscall.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace SyscallNumbers = porth::SyscallNumbers;
+
+// Whether [address, address + length) lies within the program's memory.
+bool inBounds(const porth::HostContext& host, const std::int64_t address, const std::int64_t length) {
+    return address >= 0 && length >= 0 && static_cast<std::uint64_t>(address) <= host.memSize &&
+        static_cast<std::uint64_t>(length) <= host.memSize - static_cast<std::uint64_t>(address);
+}
+
+std::int64_t writeBytes(
+    porth::HostContext& host, const std::int64_t fd, const std::int64_t buf, const std::int64_t count) {
+    if (!inBounds(host, buf, count)) {
+        return -EFAULT;
+    }
+    const char* const bytes = reinterpret_cast<const char*>(host.mem + buf);
+    if (fd == 1 || fd == 2) {
+        host.output.write(static_cast<int>(fd), {bytes, static_cast<std::size_t>(count)});
+        return count;
+    }
+#ifdef __linux__
+    const ssize_t written = ::write(static_cast<int>(fd), bytes, static_cast<std::size_t>(count));
+    return written < 0 ? -errno : written;
+#else
+    return -EBADF;
+#endif
+}
+
+#ifdef __linux__
+// The NUL-terminated string at address, or nullptr if it runs past the end of the program's memory.
+const char* stringAt(const porth::HostContext& host, const std::int64_t address) {
+    if (!inBounds(host, address, 1)) {
+        return nullptr;
+    }
+    const auto offset = static_cast<std::size_t>(address);
+    if (std::memchr(host.mem + offset, '\0', host.memSize - offset) == nullptr) {
+        return nullptr;
+    }
+    return reinterpret_cast<const char*>(host.mem + offset);
+}
+
+std::int64_t result(const std::int64_t value) {
+    return value < 0 ? -errno : value;
+}
+
+// Maps a file, or zeroes with MAP_ANONYMOUS, over [addr, addr + length) of the program's memory. The mapping is
+// always private and writable: stores from the program would fault the simulator itself on a read-only page.
+std::int64_t mapIntoMemory(porth::HostContext& host, const porth::SyscallArgs& args) {
+    const auto [addr, length, prot, flags, fd, offset] = args;
+    (void)prot;
+    if ((flags & MAP_TYPE) != MAP_PRIVATE || length <= 0) {
+        return -EINVAL;
+    }
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    if (addr % pageSize != 0) {
+        return -EINVAL;
+    }
+    // mmap works in whole pages, and none of them may reach past the program's memory.
+    const std::int64_t mappedLength = (length + pageSize - 1) / pageSize * pageSize;
+    if (!inBounds(host, addr, mappedLength)) {
+        return -ENOMEM;
+    }
+    void* const mapping = ::mmap(
+        host.mem + addr,
+        static_cast<std::size_t>(mappedLength),
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_FIXED | (flags & MAP_ANONYMOUS),
+        static_cast<int>(fd),
+        offset);
+    return mapping == MAP_FAILED ? -errno : addr;
+}
+#endif
+
+std::optional<std::int64_t> porth::forwardSyscall(
+    HostContext& host, const std::int64_t number, const SyscallArgs& args) {
+    if (number == SyscallNumbers::WRITE) {
+        return writeBytes(host, args[0], args[1], args[2]);
+    }
+    if (number == SyscallNumbers::EXIT) {
+        host.output.flush();
+        throw ProgramExit{static_cast<int>(args[0])};
+    }
+#ifdef __linux__
+    const int fd = static_cast<int>(args[0]);
+    if (number == SyscallNumbers::READ) {
+        if (!inBounds(host, args[1], args[2])) {
+            return -EFAULT;
+        }
+        // a prompt has to be on screen before the program waits for the answer
+        host.output.flush();
+        return result(::read(fd, host.mem + args[1], static_cast<std::size_t>(args[2])));
+    }
+    if (number == SyscallNumbers::OPEN) {
+        const char* const path = stringAt(host, args[0]);
+        if (path == nullptr) {
+            return -EFAULT;
+        }
+        return result(::open(path, static_cast<int>(args[1]), static_cast<mode_t>(args[2])));
+    }
+    if (number == SyscallNumbers::OPENAT) {
+        const char* const path = stringAt(host, args[1]);
+        if (path == nullptr) {
+            return -EFAULT;
+        }
+        return result(::openat(fd, path, static_cast<int>(args[2]), static_cast<mode_t>(args[3])));
+    }
+    if (number == SyscallNumbers::CLOSE || number == SyscallNumbers::LSEEK) {
+        // whatever is pending for the fd belongs before it goes away or moves
+        if (fd == 1 || fd == 2) {
+            host.output.flush();
+        }
+        if (number == SyscallNumbers::CLOSE) {
+            return result(::close(fd));
+        }
+        return result(::lseek(fd, args[1], static_cast<int>(args[2])));
+    }
+    if (number == SyscallNumbers::MMAP) {
+        return mapIntoMemory(host, args);
+    }
+#endif
+    return std::nullopt;
+}
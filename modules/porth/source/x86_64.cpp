@@ -0,0 +1,319 @@
+#include "porth/x86_64.hpp"
+
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+
+using porth::Reg;
+
+std::uint8_t low(const Reg reg) {
+    return static_cast<std::uint8_t>(static_cast<std::uint8_t>(reg) & 7);
+}
+
+bool extended(const Reg reg) {
+    return static_cast<std::uint8_t>(reg) >= 8;
+}
+
+porth::Label porth::Assembler::newLabel() {
+    labels.emplace_back();
+    return Label{labels.size() - 1};
+}
+
+void porth::Assembler::bind(const Label label) {
+    labels[label.id] = code.size();
+}
+
+std::size_t porth::Assembler::size() const {
+    return code.size();
+}
+
+void porth::Assembler::bytes(const std::string_view data) {
+    code.insert(code.end(), data.begin(), data.end());
+}
+
+void porth::Assembler::emit(const std::initializer_list<std::uint8_t> data) {
+    code.insert(code.end(), data);
+}
+
+void porth::Assembler::imm32(const std::int32_t value) {
+    std::uint8_t encoded[sizeof value];
+    std::memcpy(encoded, &value, sizeof value);
+    code.insert(code.end(), std::begin(encoded), std::end(encoded));
+}
+
+void porth::Assembler::rex(
+    const bool wide, const Reg reg, const std::optional<Reg> index, const Reg base, const bool force) {
+    const auto prefix = static_cast<std::uint8_t>(
+        0x40 | (wide ? 8 : 0) | (extended(reg) ? 4 : 0) | (index && extended(*index) ? 2 : 0) |
+        (extended(base) ? 1 : 0));
+    if (prefix != 0x40 || force) {
+        code.push_back(prefix);
+    }
+}
+
+void porth::Assembler::operand(const Reg reg, const Mem mem) {
+    operand(low(reg), mem);
+}
+
+void porth::Assembler::operand(const std::uint8_t extension, const Mem mem) {
+    // rsp and r12 as a base need a SIB byte; rbp and r13 as a base need a displacement, even a zero one.
+    const bool sib = mem.index.has_value() || low(mem.base) == 4;
+    std::uint8_t mod = 2;
+    if (mem.disp == 0 && low(mem.base) != 5) {
+        mod = 0;
+    } else if (mem.disp == static_cast<std::int8_t>(mem.disp)) {
+        mod = 1;
+    }
+    code.push_back(static_cast<std::uint8_t>(mod << 6 | (extension & 7) << 3 | (sib ? 4 : low(mem.base))));
+    if (sib) {
+        // an index of 4 means none
+        code.push_back(static_cast<std::uint8_t>((mem.index ? low(*mem.index) : 4) << 3 | low(mem.base)));
+    }
+    if (mod == 1) {
+        code.push_back(static_cast<std::uint8_t>(mem.disp));
+    } else if (mod == 2) {
+        imm32(mem.disp);
+    }
+}
+
+void porth::Assembler::registers(const Reg reg, const Reg rm) {
+    code.push_back(static_cast<std::uint8_t>(0xC0 | low(reg) << 3 | low(rm)));
+}
+
+void porth::Assembler::displacement(const Label target) {
+    references.emplace_back(code.size(), target);
+    imm32(0);
+}
+
+void porth::Assembler::mov(const Reg dst, const Reg src) {
+    rex(true, src, std::nullopt, dst);
+    emit({0x89});
+    registers(src, dst);
+}
+
+void porth::Assembler::mov(const Reg dst, const std::int64_t imm) {
+    if (imm >= 0 && imm <= UINT32_MAX) {
+        // mov r32, imm32 clears the upper half
+        rex(false, Reg::Rax, std::nullopt, dst);
+        code.push_back(static_cast<std::uint8_t>(0xB8 + low(dst)));
+        imm32(static_cast<std::int32_t>(static_cast<std::uint32_t>(imm)));
+    } else if (imm == static_cast<std::int32_t>(imm)) {
+        rex(true, Reg::Rax, std::nullopt, dst);
+        emit({0xC7});
+        registers(Reg::Rax, dst);
+        imm32(static_cast<std::int32_t>(imm));
+    } else {
+        rex(true, Reg::Rax, std::nullopt, dst);
+        code.push_back(static_cast<std::uint8_t>(0xB8 + low(dst)));
+        std::uint8_t encoded[sizeof imm];
+        std::memcpy(encoded, &imm, sizeof imm);
+        code.insert(code.end(), std::begin(encoded), std::end(encoded));
+    }
+}
+
+void porth::Assembler::mov(const Reg dst, const Mem src) {
+    rex(true, dst, src.index, src.base);
+    emit({0x8B});
+    operand(dst, src);
+}
+
+void porth::Assembler::mov(const Mem dst, const Reg src) {
+    rex(true, src, dst.index, dst.base);
+    emit({0x89});
+    operand(src, dst);
+}
+
+void porth::Assembler::mov(const Mem dst, const std::int32_t imm) {
+    rex(true, Reg::Rax, dst.index, dst.base);
+    emit({0xC7});
+    operand(std::uint8_t{0}, dst);
+    imm32(imm);
+}
+
+void porth::Assembler::movByte(const Mem dst, const Reg src) {
+    rex(false, src, dst.index, dst.base, static_cast<std::uint8_t>(src) >= 4);
+    emit({0x88});
+    operand(src, dst);
+}
+
+void porth::Assembler::movByte(const Mem dst, const std::uint8_t imm) {
+    rex(false, Reg::Rax, dst.index, dst.base);
+    emit({0xC6});
+    operand(std::uint8_t{0}, dst);
+    code.push_back(imm);
+}
+
+void porth::Assembler::movzxByte(const Reg dst, const Mem src) {
+    rex(false, dst, src.index, src.base);
+    emit({0x0F, 0xB6});
+    operand(dst, src);
+}
+
+void porth::Assembler::movzxByte(const Reg dst, const Reg src) {
+    rex(false, dst, std::nullopt, src, static_cast<std::uint8_t>(src) >= 4);
+    emit({0x0F, 0xB6});
+    registers(dst, src);
+}
+
+void porth::Assembler::lea(const Reg dst, const Mem src) {
+    rex(true, dst, src.index, src.base);
+    emit({0x8D});
+    operand(dst, src);
+}
+
+void porth::Assembler::lea(const Reg dst, const Label label) {
+    rex(true, dst, std::nullopt, Reg::Rax);
+    emit({0x8D});
+    // mod 0 with r/m 5 is RIP-relative
+    code.push_back(static_cast<std::uint8_t>(low(dst) << 3 | 5));
+    displacement(label);
+}
+
+void porth::Assembler::alu(const AluOp op, const Reg dst, const Reg src) {
+    rex(true, src, std::nullopt, dst);
+    code.push_back(static_cast<std::uint8_t>(8 * static_cast<std::uint8_t>(op) + 1));
+    registers(src, dst);
+}
+
+void porth::Assembler::alu(const AluOp op, const Reg dst, const std::int32_t imm) {
+    rex(true, Reg::Rax, std::nullopt, dst);
+    const bool fitsByte = imm == static_cast<std::int8_t>(imm);
+    code.push_back(fitsByte ? 0x83 : 0x81);
+    code.push_back(static_cast<std::uint8_t>(0xC0 | static_cast<std::uint8_t>(op) << 3 | low(dst)));
+    if (fitsByte) {
+        code.push_back(static_cast<std::uint8_t>(imm));
+    } else {
+        imm32(imm);
+    }
+}
+
+void porth::Assembler::alu(const AluOp op, const Mem dst, const Reg src) {
+    rex(true, src, dst.index, dst.base);
+    code.push_back(static_cast<std::uint8_t>(8 * static_cast<std::uint8_t>(op) + 1));
+    operand(src, dst);
+}
+
+void porth::Assembler::alu(const AluOp op, const Mem dst, const std::int32_t imm) {
+    rex(true, Reg::Rax, dst.index, dst.base);
+    const bool fitsByte = imm == static_cast<std::int8_t>(imm);
+    code.push_back(fitsByte ? 0x83 : 0x81);
+    operand(static_cast<std::uint8_t>(op), dst);
+    if (fitsByte) {
+        code.push_back(static_cast<std::uint8_t>(imm));
+    } else {
+        imm32(imm);
+    }
+}
+
+void porth::Assembler::cmpByte(const Mem dst, const std::uint8_t imm) {
+    rex(false, Reg::Rax, dst.index, dst.base);
+    emit({0x80});
+    operand(static_cast<std::uint8_t>(AluOp::Cmp), dst);
+    code.push_back(imm);
+}
+
+void porth::Assembler::test(const Reg a, const Reg b) {
+    rex(true, b, std::nullopt, a);
+    emit({0x85});
+    registers(b, a);
+}
+
+void porth::Assembler::shlCl(const Mem dst) {
+    rex(true, Reg::Rax, dst.index, dst.base);
+    emit({0xD3});
+    operand(std::uint8_t{4}, dst);
+}
+
+void porth::Assembler::sarCl(const Mem dst) {
+    rex(true, Reg::Rax, dst.index, dst.base);
+    emit({0xD3});
+    operand(std::uint8_t{7}, dst);
+}
+
+void porth::Assembler::cqo() {
+    emit({0x48, 0x99});
+}
+
+void porth::Assembler::idiv(const Reg divisor) {
+    rex(true, Reg::Rax, std::nullopt, divisor);
+    emit({0xF7});
+    code.push_back(static_cast<std::uint8_t>(0xF8 | low(divisor)));
+}
+
+void porth::Assembler::div(const Reg divisor) {
+    rex(true, Reg::Rax, std::nullopt, divisor);
+    emit({0xF7});
+    code.push_back(static_cast<std::uint8_t>(0xF0 | low(divisor)));
+}
+
+void porth::Assembler::neg(const Reg reg) {
+    rex(true, Reg::Rax, std::nullopt, reg);
+    emit({0xF7});
+    code.push_back(static_cast<std::uint8_t>(0xD8 | low(reg)));
+}
+
+void porth::Assembler::setcc(const Condition condition, const Reg dst) {
+    rex(false, Reg::Rax, std::nullopt, dst, static_cast<std::uint8_t>(dst) >= 4);
+    emit({0x0F, static_cast<std::uint8_t>(0x90 | static_cast<std::uint8_t>(condition))});
+    registers(Reg::Rax, dst);
+}
+
+void porth::Assembler::jump(const Label target) {
+    emit({0xE9});
+    displacement(target);
+}
+
+void porth::Assembler::jump(const Condition condition, const Label target) {
+    emit({0x0F, static_cast<std::uint8_t>(0x80 | static_cast<std::uint8_t>(condition))});
+    displacement(target);
+}
+
+void porth::Assembler::call(const Label target) {
+    emit({0xE8});
+    displacement(target);
+}
+
+void porth::Assembler::call(const Reg target) {
+    rex(false, Reg::Rax, std::nullopt, target);
+    emit({0xFF});
+    code.push_back(static_cast<std::uint8_t>(0xD0 | low(target)));
+}
+
+void porth::Assembler::ret() {
+    emit({0xC3});
+}
+
+void porth::Assembler::syscall() {
+    emit({0x0F, 0x05});
+}
+
+void porth::Assembler::push(const Reg reg) {
+    rex(false, Reg::Rax, std::nullopt, reg);
+    code.push_back(static_cast<std::uint8_t>(0x50 + low(reg)));
+}
+
+void porth::Assembler::pop(const Reg reg) {
+    rex(false, Reg::Rax, std::nullopt, reg);
+    code.push_back(static_cast<std::uint8_t>(0x58 + low(reg)));
+}
+
+void porth::Assembler::repMovsb() {
+    emit({0xF3, 0xA4});
+}
+
+void porth::Assembler::repneScasb() {
+    emit({0xF2, 0xAE});
+}
+
+std::vector<std::uint8_t> porth::Assembler::finish() const {
+    std::vector<std::uint8_t> result = code;
+    for (const auto& [at, label] : references) {
+        if (!labels[label.id]) {
+            throw std::runtime_error{"reference to a label that was never bound"};
+        }
+        const auto displacement = static_cast<std::int32_t>(
+            static_cast<std::int64_t>(*labels[label.id]) - static_cast<std::int64_t>(at + sizeof(std::int32_t)));
+        std::memcpy(result.data() + at, &displacement, sizeof displacement);
+    }
+    return result;
+}
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <porth/lexer.hpp>
+#include <porth/op.hpp>
+#include <porth/parser.hpp>
+#include <porth/source_map.hpp>
+#include <random>
+#include <span/span.hpp>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::string_view_literals;
+
+// Every allocation carries its size in a header so the benchmark can track the bytes in use and their peak.
+struct AllocationStats {
+    std::size_t count = 0;
+    std::size_t current = 0;
+    std::size_t peak = 0;
+};
+
+AllocationStats allocationStats;
+
+constexpr std::size_t ALLOCATION_HEADER = alignof(std::max_align_t);
+
+void* operator new(const std::size_t size) {
+    auto* block = static_cast<unsigned char*>(std::malloc(size + ALLOCATION_HEADER));
+    if (block == nullptr) {
+        throw std::bad_alloc{};
+    }
+    *reinterpret_cast<std::size_t*>(block) = size;
+    ++allocationStats.count;
+    allocationStats.current += size;
+    allocationStats.peak = std::max(allocationStats.peak, allocationStats.current);
+    return block + ALLOCATION_HEADER;
+}
+
+void operator delete(void* pointer) noexcept {
+    if (pointer == nullptr) {
+        return;
+    }
+    unsigned char* block = static_cast<unsigned char*>(pointer) - ALLOCATION_HEADER;
+    allocationStats.current -= *reinterpret_cast<std::size_t*>(block);
+    std::free(block);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    operator delete(pointer);
+}
+
+// Deterministic synthetic programs that stress one part of the front end each.
+std::string generateLiteralRuns(std::mt19937& rng, const std::size_t targetSize) {
+    std::ostringstream source;
+    while (static_cast<std::size_t>(source.tellp()) < targetSize) {
+        const std::size_t runLength = 8 + rng() % 56;
+        for (std::size_t i = 0; i < runLength; ++i) {
+            source << rng() % 1'000'000'007 << (i % 16 == 15 ? "\n" : " ");
+        }
+        source << "\n";
+        for (std::size_t i = 0; i < runLength; ++i) {
+            source << "drop ";
+        }
+        source << "\n";
+    }
+    return source.str();
+}
+
+std::string generateDeepWhiles(std::mt19937& rng, const std::size_t targetSize) {
+    std::ostringstream source;
+    while (static_cast<std::size_t>(source.tellp()) < targetSize) {
+        const std::size_t depth = 16 + rng() % 240;
+        for (std::size_t level = 0; level < depth; ++level) {
+            source << std::string(level % 64, ' ') << "0 while dup " << rng() % 100 << " < do\n";
+        }
+        for (std::size_t level = depth; level > 0; --level) {
+            source << std::string((level - 1) % 64, ' ') << "1 + end drop\n";
+        }
+    }
+    return source.str();
+}
+
+std::string generateIfElseChains(std::mt19937& rng, const std::size_t targetSize) {
+    std::ostringstream source;
+    while (static_cast<std::size_t>(source.tellp()) < targetSize) {
+        const std::size_t width = 4 + rng() % 60;
+        source << "mem , dup\n";
+        for (std::size_t branch = 0; branch < width; ++branch) {
+            source << "dup " << branch << " = if " << rng() % 256 << " print else // branch " << branch << "\n";
+        }
+        source << "drop\n";
+        for (std::size_t branch = 0; branch < width; ++branch) {
+            source << "end ";
+        }
+        source << "drop\n";
+    }
+    return source.str();
+}
+
+struct Measurement {
+    double seconds;
+    AllocationStats allocations;
+};
+
+template <typename Work> Measurement measure(const std::size_t repeat, Work work) {
+    Measurement best{std::numeric_limits<double>::infinity(), {}};
+    for (std::size_t i = 0; i < repeat; ++i) {
+        // each run records its locations into a fresh map, instead of growing the one every earlier run filled
+        porth::sourceMap() = porth::SourceMap{};
+        const AllocationStats before = allocationStats;
+        allocationStats.peak = allocationStats.current;
+        const auto start = std::chrono::steady_clock::now();
+        work();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best.seconds) {
+            best.seconds = elapsed.count();
+            best.allocations.count = allocationStats.count - before.count;
+            best.allocations.peak = allocationStats.peak - before.current;
+        }
+    }
+    return best;
+}
+
+void report(const std::string& phase, const Measurement& m, const double bytes, const double ops) {
+    std::cout << "  " << std::left << std::setw(24) << phase << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << m.seconds * 1000 << " ms";
+    if (bytes > 0) {
+        std::cout << std::setw(10) << std::setprecision(1) << bytes / m.seconds / 1e6 << " MB/s";
+    } else {
+        std::cout << std::setw(15) << "";
+    }
+    std::cout << std::setw(10) << std::setprecision(2) << ops / m.seconds / 1e6 << " Mops/s";
+    std::cout << std::setw(10) << m.allocations.count << " allocs";
+    std::cout << std::setw(10) << std::setprecision(1) << static_cast<double>(m.allocations.peak) / 1e6
+              << " MB peak\n";
+}
+
+void benchmark(const std::string& name, const std::string& source, const std::size_t repeat) {
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / ("porth_bench_" + name + ".porth");
+    if (std::ofstream file{path, std::ios::binary}; !(file << source)) {
+        std::cerr << "[ERROR] failed to write " << path.string() << "\n";
+        std::exit(1);
+    }
+    const auto bytes = static_cast<double>(source.size());
+
+    std::vector<porth::Token> tokens;
+    std::vector<porth::Op> program;
+    const Measurement scalarLex = measure(repeat, [&] {
+        tokens = porth::lexFile(path.string(), porth::ScanMode::Scalar);
+    });
+    const Measurement vectorLex = measure(repeat, [&] { tokens = porth::lexFile(path.string()); });
+    const Measurement parse = measure(repeat, [&] {
+        program.clear();
+        program.shrink_to_fit();
+        for (const porth::Token& token : tokens) {
+            program.push_back(porth::parseTokenAsOp(token));
+        }
+    });
+    const std::vector<porth::Op> unresolved = program;
+    const Measurement crossReference = measure(repeat, [&] {
+        program = unresolved;
+        porth::crossReferenceBlocks(program);
+    });
+    const Measurement load = measure(repeat, [&] { program = porth::loadProgramFromFile(path.string()); });
+
+    const auto ops = static_cast<double>(program.size());
+    std::cout << "[INFO] " << name << ": " << std::setprecision(2) << std::fixed << bytes / 1e6 << " MB, "
+              << program.size() << " ops\n";
+    report("lexFile (scalar)", scalarLex, bytes, ops);
+    report("lexFile (vector)", vectorLex, bytes, ops);
+    report("parseTokenAsOp", parse, 0, ops);
+    report("crossReferenceBlocks", crossReference, 0, ops);
+    report("loadProgramFromFile", load, bytes, ops);
+    std::filesystem::remove(path);
+}
+
+void usage(const std::string& exeName) {
+    std::cout << "Usage: " << exeName << " [OPTIONS]\n";
+    std::cout << "  OPTIONS:\n";
+    std::cout << "    -size <MB>     Size of each generated program. (Default: 8)\n";
+    std::cout << "    -repeat <n>    Runs per phase; the fastest is reported. (Default: 5)\n";
+    std::cout << "    -seed <n>      Seed of the program generator. (Default: 1)\n";
+}
+
+int main(const int argc, char** argv) {
+    const span::Span<char*> args{argv, static_cast<std::size_t>(argc)};
+    std::size_t cursor = 0;
+    const std::string exeName = args[cursor++];
+    std::size_t sizeMb = 8;
+    std::size_t repeat = 5;
+    unsigned long seed = 1;
+
+    while (args.size() > cursor) {
+        const std::string_view arg = args[cursor++];
+        if (arg == "help"sv) {
+            usage(exeName);
+            return 0;
+        }
+        if (args.size() == cursor || (arg != "-size"sv && arg != "-repeat"sv && arg != "-seed"sv)) {
+            usage(exeName);
+            std::cerr << "[ERROR] unknown or incomplete option '" << arg << "'\n";
+            return 1;
+        }
+        const std::string_view text = args[cursor++];
+        unsigned long value = 0;
+        if (const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+            error != std::errc{} || end != text.data() + text.size()) {
+            std::cerr << "[ERROR] invalid value '" << text << "' for '" << arg << "'\n";
+            return 1;
+        }
+        if (arg == "-size"sv) {
+            sizeMb = value;
+        } else if (arg == "-repeat"sv) {
+            repeat = std::max(1UL, value);
+        } else {
+            seed = value;
+        }
+    }
+
+    std::mt19937 rng{static_cast<std::mt19937::result_type>(seed)};
+    const std::size_t targetSize = sizeMb * 1'000'000;
+    benchmark("literals", generateLiteralRuns(rng, targetSize), repeat);
+    benchmark("whiles", generateDeepWhiles(rng, targetSize), repeat);
+    benchmark("if-else", generateIfElseChains(rng, targetSize), repeat);
+    return 0;
+}
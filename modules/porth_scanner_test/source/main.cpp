@@ -0,0 +1,210 @@
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <porth/lexer.hpp>
+#include <porth/parse_error.hpp>
+#include <porth/parser.hpp>
+#include <porth/perf_counters.hpp>
+#include <porth/scanner.hpp>
+#include <porth/source_map.hpp>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+bool sameLocation(const porth::SourceLocation& a, const porth::SourceLocation& b) {
+    return a.filePath == b.filePath && a.lineNumber == b.lineNumber && a.columnNumber == b.columnNumber;
+}
+
+bool compareTokens(
+    const std::filesystem::path& path,
+    const std::string& what,
+    const std::vector<porth::Token>& expected,
+    const std::vector<porth::Token>& actual) {
+    if (expected.size() != actual.size()) {
+        std::cerr << "[ERROR] " << path.string() << ": " << what << ": expected " << expected.size()
+                  << " tokens, got " << actual.size() << "\n";
+        return false;
+    }
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        const porth::SourceLocation expectedLocation = porth::sourceMap().resolve(expected[i].location);
+        const porth::SourceLocation actualLocation = porth::sourceMap().resolve(actual[i].location);
+        if (!(expected[i].id == actual[i].id) || expected[i].token != actual[i].token ||
+            expected[i].value != actual[i].value || !sameLocation(expectedLocation, actualLocation)) {
+            std::cerr << "[ERROR] " << path.string() << ": " << what << ": token " << i << " differs\n";
+            std::cerr << "  Expected: " << expectedLocation << " '" << expected[i].token << "'\n";
+            std::cerr << "  Actual:   " << actualLocation << " '" << actual[i].token << "'\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool compareLexers(const std::filesystem::path& path) {
+    const std::vector<porth::Token> scalar = porth::lexFile(path.string(), porth::ScanMode::Scalar);
+    const std::vector<porth::Token> vector = porth::lexFile(path.string(), porth::ScanMode::Vector);
+    bool ok = compareTokens(path, "vector lexer", scalar, vector);
+    for (const std::size_t threadCount : {2, 3, 8}) {
+        const std::vector<porth::Token> parallel = porth::lexFileParallel(path.string(), threadCount);
+        ok = compareTokens(path, std::to_string(threadCount) + "-thread lexer", scalar, parallel) && ok;
+    }
+    return ok;
+}
+
+std::size_t testFolder(const std::filesystem::path& folder) {
+    std::size_t failed = 0;
+    for (const std::filesystem::recursive_directory_iterator files{folder}; const auto& entry : files) {
+        if (entry.is_directory() || entry.path().extension() != ".porth") {
+            continue;
+        }
+        std::cout << "[INFO] Lexing " << entry.path().filename().string() << "\n";
+        if (!compareLexers(entry.path())) {
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+// Tokens and comments straddling block boundaries, CRLF line endings and a file that ends mid-token.
+std::size_t testBlockBoundaries() {
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "porth_scanner_test.porth";
+    std::mt19937 rng{42};
+    const std::string pieces[] = {"1", "23", "dup", "//", "// x", "//x", "/", " ", "  ", "\t", "\n", "\r\n", "+"};
+    std::string source;
+    while (source.size() < 64 * 64) {
+        source += pieces[rng() % std::size(pieces)];
+    }
+    source += "end";
+    if (std::ofstream file{path, std::ios::binary}; !(file << source)) {
+        std::cerr << "[ERROR] failed to write " << path.string() << "\n";
+        return 1;
+    }
+    std::cout << "[INFO] Lexing generated block boundary cases\n";
+    const bool ok = compareLexers(path);
+    std::filesystem::remove(path);
+    return ok ? 0 : 1;
+}
+
+std::string loadError(const std::filesystem::path& path, const std::size_t lexThreads) {
+    try {
+        porth::loadProgramFromFile(path.string(), lexThreads);
+    } catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    return "no error";
+}
+
+// An unknown word near the start must win over a bad integer that a later chunk finds first.
+std::size_t testErrorOrder() {
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "porth_scanner_test_errors.porth";
+    std::string source = "1 frobnicate\n";
+    while (source.size() < 64 * 1024) {
+        source += "1 2 + drop\n";
+    }
+    source += "99999999999999999999999\n";
+    if (std::ofstream file{path, std::ios::binary}; !(file << source)) {
+        std::cerr << "[ERROR] failed to write " << path.string() << "\n";
+        return 1;
+    }
+    std::cout << "[INFO] Comparing the first error of the sequential and parallel front ends\n";
+    const std::string expected = loadError(path, 1);
+    std::size_t failed = 0;
+    for (const std::size_t threadCount : {2, 8}) {
+        if (const std::string actual = loadError(path, threadCount); actual != expected) {
+            std::cerr << "[ERROR] " << threadCount << "-thread front end: expected '" << expected << "', got '"
+                      << actual << "'\n";
+            ++failed;
+        }
+    }
+    std::filesystem::remove(path);
+    return failed;
+}
+
+// Rewriting a file that was lexed before, shorter and then longer, must lex the new contents.
+std::size_t testRewrittenFile() {
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "porth_scanner_test_rewrite.porth";
+    std::cout << "[INFO] Lexing a file rewritten in between\n";
+    std::size_t failed = 0;
+    for (const std::size_t count : {20000, 3, 50000}) {
+        std::string source;
+        for (std::size_t i = 0; i < count; ++i) {
+            source += "12345 ";
+        }
+        if (std::ofstream file{path, std::ios::binary | std::ios::trunc}; !(file << source)) {
+            std::cerr << "[ERROR] failed to write " << path.string() << "\n";
+            return 1;
+        }
+        if (const std::size_t tokens = porth::lexFile(path.string()).size(); tokens != count) {
+            std::cerr << "[ERROR] expected " << count << " tokens, got " << tokens << "\n";
+            ++failed;
+        }
+    }
+    std::filesystem::remove(path);
+    return failed;
+}
+
+// Counters that were never started count nothing, as on a host without them: every event must be reported as not
+// counted, without ratios, and with a reason.
+std::size_t testPerfStatWithoutCounters() {
+    std::cout << "[INFO] Reporting performance counters that counted nothing\n";
+    const porth::PerfCounters counters;
+    std::ostringstream report;
+    porth::writePerfStat(report, counters, 42);
+    const std::string text = report.str();
+    std::size_t failed = 0;
+    const auto expect = [&](const bool condition, const std::string_view what) {
+        if (!condition) {
+            std::cerr << "[ERROR] the report " << what << ":\n" << text;
+            ++failed;
+        }
+    };
+    expect(text.starts_with("[INFO] Performance counters for 42 executed instructions\n"), "has no header");
+    std::size_t notCounted = 0;
+    for (std::size_t at = 0; (at = text.find("not counted\n", at)) != std::string::npos; ++at) {
+        ++notCounted;
+    }
+    expect(notCounted == static_cast<std::size_t>(porth::PerfEvent::Count), "counted some events");
+    expect(text.find("IPC") == std::string::npos && text.find("miss rate") == std::string::npos, "has ratios");
+    const std::string_view warning = "[WARN] Hardware counters are not available: ";
+    const std::size_t at = text.find(warning);
+    expect(at != std::string::npos && text.compare(at + warning.size(), 1, "\n") != 0, "gives no reason");
+    return failed;
+}
+
+std::size_t testClassifiers() {
+    std::cout << "[INFO] Classifying random blocks\n";
+    std::mt19937 rng{1};
+    std::string bytes(porth::SCAN_BLOCK_SIZE, '\0');
+    for (std::size_t round = 0; round < 10000; ++round) {
+        for (char& c : bytes) {
+            c = static_cast<char>(rng() % 2 == 0 ? rng() % 256 : " \t\n\v\f\r/a"[rng() % 8]);
+        }
+        const std::size_t length = rng() % (porth::SCAN_BLOCK_SIZE + 1);
+        const porth::ByteClasses expected = porth::classifyBytesScalar(bytes.data(), length);
+        const porth::ByteClasses actual = porth::classifyBytesVector(bytes.data(), length);
+        if (expected.whitespace != actual.whitespace || expected.newlines != actual.newlines ||
+            expected.slashes != actual.slashes) {
+            std::cerr << "[ERROR] byte classes differ for a block of length " << length << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main() {
+    std::size_t failed = testClassifiers();
+    failed += testBlockBoundaries();
+    failed += testErrorOrder();
+    failed += testRewrittenFile();
+    failed += testPerfStatWithoutCounters();
+    failed += testFolder(std::filesystem::current_path() / "tests");
+    failed += testFolder(std::filesystem::current_path() / "examples");
+
+    std::cout << "\n";
+    std::cout << "Failed: " << failed << "\n";
+    return failed > 0 ? 1 : 0;
+}
@@ -2,6 +2,7 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <ranges/ranges.hpp>
 #include <regex>
 #include <span/span.hpp>
@@ -10,6 +11,7 @@
 #include <string>
 #include <subprocess.h>
 #include <testconfig.hpp>
+#include <utility>
 #include <vector>
 
 struct SubprocessError final : std::runtime_error {
@@ -17,7 +19,9 @@ struct SubprocessError final : std::runtime_error {
     }
 };
 
-std::string runSubprocess(const std::vector<std::string>& args) {
+// With allowFailure, a nonzero exit code is not an error but ends the output as `[EXIT] <code>`, so that the expected
+// output of a test can include the error a program stops with.
+std::string runSubprocess(const std::vector<std::string>& args, const bool allowFailure = false) {
     std::cout << "[CMD] ";
     for (std::size_t i = 0; i < args.size(); ++i) {
         std::cout << args[i];
@@ -54,7 +58,9 @@ std::string runSubprocess(const std::vector<std::string>& args) {
         errorMessage << "failed to join subprocess for '" << args[0] << "'";
         throw SubprocessError{errorMessage.str()};
     }
-    if (code != 0) {
+    if (code != 0 && allowFailure) {
+        result += "[EXIT] " + std::to_string(code) + "\n";
+    } else if (code != 0) {
         std::cerr << result << "\n";
         std::ostringstream errorMessage;
         errorMessage << "'" << args[0] << "' failed with code " << code;
@@ -66,9 +72,50 @@ std::string runSubprocess(const std::vector<std::string>& args) {
     return std::regex_replace(result, crlf, "\n");
 }
 
+// The contents of the file with CRLF line endings turned into LF, or nothing if it cannot be read.
+std::optional<std::string> readFile(const std::filesystem::path& path) {
+    std::ifstream file{path.string()};
+    std::ostringstream contents;
+    if (!(contents << file.rdbuf())) {
+        return std::nullopt;
+    }
+    const std::regex crlf{"\r\n"};
+    return std::regex_replace(contents.str(), crlf, "\n");
+}
+
+// The reports `sim -profile` writes next to the program, and where a test that checks them records what to expect.
+const std::vector<std::pair<std::string, std::string>> PROFILE_REPORTS{
+    {".prof", ".prof.txt"},
+    {".folded", ".folded.txt"},
+};
+
+// Prints both outputs and returns false when they differ.
+bool checkOutput(const std::string& what, const std::string& expectedOutput, const std::string& actualOutput) {
+    if (actualOutput == expectedOutput) {
+        return true;
+    }
+    std::cerr << "[ERROR] Unexpected " << what << " output\n";
+    std::cerr << "  Expected:\n";
+    std::istringstream expectedStream{expectedOutput};
+    std::string line;
+    while (std::getline(expectedStream, line)) {
+        std::cerr << "    " << line << "\n";
+    }
+    std::cerr << "  Actual:\n";
+    std::istringstream actualStream{actualOutput};
+    while (std::getline(actualStream, line)) {
+        std::cerr << "    " << line << "\n";
+    }
+    return false;
+}
+
 int test(const std::filesystem::path& folder) {
     std::size_t simFailed = 0;
     std::size_t comFailed = 0;
+    std::size_t jitFailed = 0;
+    // starts out empty, so every program is built once and then fetched from the cache
+    const std::filesystem::path cacheDir = folder / ".build-cache";
+    std::filesystem::remove_all(cacheDir);
 
     for (const std::filesystem::recursive_directory_iterator tests{folder}; const auto& entry : tests) {
         if (entry.is_directory()) {
@@ -82,60 +129,109 @@ int test(const std::filesystem::path& folder) {
 
         std::filesystem::path txtPath = entry.path();
         txtPath.replace_extension(".txt");
-        std::ifstream txtFile{txtPath.string()};
-        std::ostringstream txtContentsStream;
-        if (!(txtContentsStream << txtFile.rdbuf())) {
+        const std::optional<std::string> expectedOutput = readFile(txtPath);
+        if (!expectedOutput) {
             std::cerr << "[ERROR] failed to read " << txtPath.string() << "\n";
             return 1;
         }
-        const std::regex crlf{"\r\n"};
-        const std::string expectedOutput = std::regex_replace(txtContentsStream.str(), crlf, "\n");
 
+        // relative to the working directory, like the expected errors that name it
+        const std::string programPath = std::filesystem::relative(entry.path()).string();
         try {
-            if (const std::string simOutput = runSubprocess({PORTH_CPP_EXE, "sim", entry.path().string()});
-                simOutput != expectedOutput) {
-                std::cerr << "[ERROR] Unexpected simulation output\n";
-                std::cerr << "  Expected:\n";
-                std::istringstream expectedStream{expectedOutput};
-                std::string line;
-                while (std::getline(expectedStream, line)) {
-                    std::cerr << "    " << line << "\n";
-                }
-                std::cerr << "  Actual:\n";
-                std::istringstream simStream{simOutput};
-                while (std::getline(simStream, line)) {
-                    std::cerr << "    " << line << "\n";
+            const std::vector<std::pair<std::string, std::vector<std::string>>> simulations{
+                {"simulation", {"sim"}},
+                {"unoptimized simulation", {"-O0", "sim"}},
+                {"unfused simulation", {"sim", "-no-fuse"}},
+                {"top-of-stack simulation", {"sim", "-engine=tos"}},
+                // loads and stores that range analysis proved in bounds skip their check, which must not change a thing
+                {"checked simulation", {"-checked", "sim"}},
+            };
+            for (const auto& [what, options] : simulations) {
+                std::vector<std::string> args{PORTH_CPP_EXE};
+                args.insert(args.end(), options.begin(), options.end());
+                args.push_back(programPath);
+                if (!checkOutput(what, *expectedOutput, runSubprocess(args, true))) {
+                    ++simFailed;
                 }
+            }
+
+            // -perfstat reports after the program's output, and must not change it or its exit code, whether the host
+            // has the counters or not
+            const std::size_t exitLine = expectedOutput->rfind("[EXIT] ");
+            const std::string programOutput = expectedOutput->substr(0, exitLine);
+            const std::string exitOutput = exitLine == std::string::npos ? "" : expectedOutput->substr(exitLine);
+            if (const std::string perfStatOutput =
+                    runSubprocess({PORTH_CPP_EXE, "sim", "-perfstat", programPath}, true);
+                !perfStatOutput.starts_with(programOutput + "[INFO] Performance counters for ") ||
+                !perfStatOutput.ends_with(exitOutput)) {
+                checkOutput("-perfstat simulation", *expectedOutput, perfStatOutput);
                 ++simFailed;
             }
 
+            // programs that come with the reports to expect are also profiled
+            std::filesystem::path reportStem = entry.path();
+            reportStem.replace_extension();
+            if (std::filesystem::exists(reportStem.string() + PROFILE_REPORTS[0].second)) {
+                runSubprocess({PORTH_CPP_EXE, "sim", "-profile", programPath}, true);
+                for (const auto& [extension, expectedExtension] : PROFILE_REPORTS) {
+                    const std::optional<std::string> expectedReport = readFile(reportStem.string() + expectedExtension);
+                    const std::optional<std::string> report = readFile(programPath + extension);
+                    if (!expectedReport || !report || !checkOutput(extension + " profile", *expectedReport, *report)) {
+                        ++simFailed;
+                    }
+                }
+            }
+
+#if defined(__x86_64__) && !defined(_WIN32)
+            for (const bool checked : {false, true}) {
+                std::vector<std::string> args{PORTH_CPP_EXE, "jit", programPath};
+                if (checked) {
+                    args.insert(args.begin() + 1, "-checked");
+                }
+                if (!checkOutput(checked ? "checked JIT" : "JIT", *expectedOutput, runSubprocess(args, true))) {
+                    ++jitFailed;
+                }
+            }
+#endif
+
             std::filesystem::path exePath = entry.path();
 #ifdef _WIN32
             exePath.replace_extension(".exe");
 #else
             exePath.replace_extension();
 #endif
-            runSubprocess({
-                PORTH_CPP_EXE,
-                "com",
-                "-o",
-                exePath.string(),
-                entry.path().string(),
-            });
-            if (const std::string comOutput = runSubprocess({exePath.string()}); comOutput != expectedOutput) {
-                std::cerr << "[ERROR] Unexpected compilation output\n";
-                std::cerr << "  Expected:\n";
-                std::istringstream expectedStream{expectedOutput};
-                std::string line;
-                while (std::getline(expectedStream, line)) {
-                    std::cerr << "    " << line << "\n";
+            // the ELF backend only targets x86-64 Linux
+#if defined(__linux__) && defined(__x86_64__)
+            const std::vector<std::string> backends{"cpp", "elf"};
+#else
+            const std::vector<std::string> backends{"cpp"};
+#endif
+            for (const std::string& backend : backends) {
+                for (int build = 0; build < 2; ++build) {
+                    const std::string buildOutput = runSubprocess({
+                        PORTH_CPP_EXE,
+                        "com",
+                        "-backend=" + backend,
+                        "-cache-dir",
+                        cacheDir.string(),
+                        "-o",
+                        exePath.string(),
+                        programPath,
+                    });
+                    // the second build must come from the cache the first one filled
+                    const bool reused = buildOutput.find("[INFO] Reused the cached executable ") != std::string::npos;
+                    if (reused != (build == 1)) {
+                        std::cerr << "[ERROR] build " << build + 1 << " with the " << backend << " backend "
+                                  << (reused ? "reused" : "did not reuse") << " a cached executable\n";
+                        ++comFailed;
+                    }
                 }
-                std::cerr << "  Actual:\n";
-                std::istringstream comStream{comOutput};
-                while (std::getline(comStream, line)) {
-                    std::cerr << "    " << line << "\n";
+                if (!checkOutput(
+                        "compilation with the " + backend + " backend",
+                        *expectedOutput,
+                        runSubprocess({exePath.string()}, true))) {
+                    ++comFailed;
                 }
-                ++comFailed;
             }
         } catch (const SubprocessError& e) {
             std::cout << "[ERROR] " << e.what() << "\n";
@@ -144,8 +240,9 @@ int test(const std::filesystem::path& folder) {
     }
 
     std::cout << "\n";
-    std::cout << "Simulation failed: " << simFailed << ", Compilation failed: " << comFailed << "\n";
-    if (simFailed > 0 || comFailed > 0) {
+    std::cout << "Simulation failed: " << simFailed << ", JIT failed: " << jitFailed
+              << ", Compilation failed: " << comFailed << "\n";
+    if (simFailed > 0 || jitFailed > 0 || comFailed > 0) {
         return 1;
     }
     return 0;
@@ -165,9 +262,21 @@ void record(const std::filesystem::path& folder) {
         std::filesystem::path txtPath = entry.path();
         txtPath.replace_extension(".txt");
         std::ostringstream txtContentsStream;
+        const std::string programPath = std::filesystem::relative(entry.path()).string();
+        std::filesystem::path reportStem = entry.path();
+        reportStem.replace_extension();
         try {
-            const std::string simOutput = runSubprocess({PORTH_CPP_EXE, "sim", entry.path().string()});
+            const std::string simOutput = runSubprocess({PORTH_CPP_EXE, "sim", programPath}, true);
             txtContentsStream << simOutput;
+            if (std::filesystem::exists(reportStem.string() + PROFILE_REPORTS[0].second)) {
+                runSubprocess({PORTH_CPP_EXE, "sim", "-profile", programPath}, true);
+                for (const auto& [extension, expectedExtension] : PROFILE_REPORTS) {
+                    std::filesystem::copy_file(
+                        programPath + extension,
+                        reportStem.string() + expectedExtension,
+                        std::filesystem::copy_options::overwrite_existing);
+                }
+            }
         } catch (const SubprocessError& e) {
             std::cout << "[ERROR] " << e.what() << "\n";
             return;